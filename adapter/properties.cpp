@@ -28,17 +28,13 @@
 #include <cstdio>
 #include <cstring>
 #include <fstream>
-#include <shared_mutex>
+#include <mutex>
 #include <unistd.h>
 #include <sys/uio.h>
-#include <unordered_map>
 #include <pthread.h>
 
 using namespace std;
 
-using ReadLock = shared_lock<shared_timed_mutex>;
-using InsertLock = unique_lock<shared_timed_mutex>;
-
 static pthread_mutex_t g_globalLevelLock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t g_tagLevelLock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t g_domainLevelLock = PTHREAD_MUTEX_INITIALIZER;
@@ -47,6 +43,17 @@ static pthread_mutex_t g_persistDebugLock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t g_privateLock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t g_processFlowLock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t g_domainFlowLock = PTHREAD_MUTEX_INITIALIZER;
+static constexpr uint32_t INVALID_GENERATION = 0xffffffff;
+static constexpr uint32_t LEVEL_CACHE_BITS = 8;
+static constexpr uint32_t LEVEL_CACHE_SIZE = 1 << LEVEL_CACHE_BITS;
+static constexpr uint32_t LEVEL_CACHE_PROBE = 8;
+static constexpr uint64_t LEVEL_CACHE_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+static constexpr uint64_t LEVEL_CACHE_HASH_PRIME = 0x100000001B3ULL;
+static constexpr uint64_t LEVEL_CACHE_HASH_BASIS = 0xCBF29CE484222325ULL;
+static constexpr uint32_t LEVEL_CACHE_TAG_LEN = 32; /* MAX_TAG_LEN of hilog, '\0' included */
+static constexpr uint32_t LEVEL_CACHE_TAG_WORDS = LEVEL_CACHE_TAG_LEN / sizeof(uint64_t);
+static constexpr uint32_t LEVEL_CACHE_TABLES = 2;
+static constexpr uint32_t LEVEL_CACHE_STAT_BATCH = 256;
 
 using PropertyCache = struct {
     const void* pinfo;
@@ -54,16 +61,57 @@ using PropertyCache = struct {
     char propertyValue[HILOG_PROP_VALUE_MAX];
 };
 
+/*
+ * generation is the global property serial the cached value was last refreshed against,
+ * so the hot path costs a single load of the shared serial instead of a per-key check.
+ */
 using SwitchCache = struct {
     PropertyCache cache;
-    bool isOn;
+    atomic<uint32_t> generation;
+    atomic<bool> isOn;
 };
 
 using LogLevelCache = struct {
     PropertyCache cache;
-    uint16_t logLevel;
+    atomic<uint32_t> generation;
+    atomic<uint16_t> logLevel;
+};
+
+/*
+ * Bounded cache of domain/tag levels: open addressing over LEVEL_CACHE_PROBE slots, keyed by
+ * domain or tag hash. Readers never lock, writers are serialized by writeLock and publish each
+ * slot through its sequence counter. When the probe window is full a slot is evicted by CLOCK.
+ * A tag slot keeps the tag text as well, a hit needs both the hash and the text to match. The text is
+ * kept in atomic words, so a reader racing a writer copies them without a data race and compares
+ * its copy only once the sequence shows the copy is whole.
+ */
+using LevelCacheSlot = struct {
+    atomic<uint32_t> seq; /* 0: never used, odd: being written */
+    atomic<uint64_t> key;
+    atomic<uint32_t> generation;
+    atomic<uint16_t> logLevel;
+    atomic<bool> referenced;
+    atomic<uint64_t> tag[LEVEL_CACHE_TAG_WORDS]; /* zero padded */
+};
+
+/* hits and misses are counted per thread and added to the table LEVEL_CACHE_STAT_BATCH at a time */
+using LevelCacheTable = struct {
+    LevelCacheSlot slots[LEVEL_CACHE_SIZE];
+    mutex writeLock;
+    uint32_t clockHand;
+    uint32_t index; /* of the counters of the table in g_levelCacheCounts */
+    atomic<uint64_t> hits;
+    atomic<uint64_t> misses;
+    atomic<uint64_t> evictions;
+};
+
+using LevelCacheCounts = struct {
+    uint32_t hits;
+    uint32_t misses;
 };
 
+static thread_local LevelCacheCounts g_levelCacheCounts[LEVEL_CACHE_TABLES];
+
 using ProcessInfo = struct {
     PropertyCache cache;
     string propertyKey;
@@ -185,44 +233,42 @@ static void RefreshCacheBuf(PropertyCache *cache, const char *key)
     /* use OHOS interface */
 }
 
-static bool CheckCache(const PropertyCache *cache)
+static uint32_t GetGlobalSerial()
 {
-    return true;
-    /* use OHOS interface */
+    return 0;
+    /* use OHOS interface, serial of the shared property area, bumped on every property change */
 }
 
-static bool GetSwitchCache(bool isFirst, SwitchCache& switchCache, uint32_t propType, bool defaultValue)
+static bool GetSwitchValue(const char *propertyValue, bool defaultValue)
 {
-    int notLocked;
-    string key = GetPropertyName(propType);
+    if (strcmp(propertyValue, "true") == 0) {
+        return true;
+    } else if (strcmp(propertyValue, "false") == 0) {
+        return false;
+    }
+    return defaultValue;
+}
 
-    if (isFirst || CheckCache(&switchCache.cache)) {
-        notLocked = LockByProp(propType);
-        if (!notLocked) {
-            RefreshCacheBuf(&switchCache.cache, key.c_str());
-            if (strcmp(switchCache.cache.propertyValue, "true") == 0) {
-                switchCache.isOn = true;
-            } else if (strcmp(switchCache.cache.propertyValue, "false") == 0) {
-                switchCache.isOn = false;
-            } else {
-                switchCache.isOn = defaultValue;
-            }
-            UnlockByProp(propType);
-            return switchCache.isOn;
-        } else {
-            SwitchCache tmpCache = {{nullptr, 0xffffffff, ""}, defaultValue};
-            RefreshCacheBuf(&tmpCache.cache, key.c_str());
-            if (strcmp(tmpCache.cache.propertyValue, "true") == 0) {
-                tmpCache.isOn = true;
-            } else if (strcmp(tmpCache.cache.propertyValue, "false") == 0) {
-                tmpCache.isOn = false;
-            } else {
-                tmpCache.isOn = defaultValue;
-            }
-            return tmpCache.isOn;
-        }
+static bool GetSwitchCache(SwitchCache& switchCache, uint32_t propType, bool defaultValue)
+{
+    uint32_t generation = GetGlobalSerial();
+    if (switchCache.generation.load(memory_order_acquire) == generation) {
+        return switchCache.isOn.load(memory_order_relaxed);
+    }
+
+    string key = GetPropertyName(propType);
+    int notLocked = LockByProp(propType);
+    if (!notLocked) {
+        RefreshCacheBuf(&switchCache.cache, key.c_str());
+        bool isOn = GetSwitchValue(switchCache.cache.propertyValue, defaultValue);
+        switchCache.isOn.store(isOn, memory_order_relaxed);
+        switchCache.generation.store(generation, memory_order_release);
+        UnlockByProp(propType);
+        return isOn;
     } else {
-        return switchCache.isOn;
+        PropertyCache tmpCache = {nullptr, 0xffffffff, ""};
+        RefreshCacheBuf(&tmpCache, key.c_str());
+        return GetSwitchValue(tmpCache.propertyValue, defaultValue);
     }
 }
 
@@ -233,42 +279,32 @@ bool IsDebugOn()
 
 bool IsSingleDebugOn()
 {
-    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, false};
-    static atomic_flag isFirstFlag = ATOMIC_FLAG_INIT;
-    bool isFirst = !isFirstFlag.test_and_set();
-    return GetSwitchCache(isFirst, *switchCache, PROP_SINGLE_DEBUG, false);
+    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, {INVALID_GENERATION}, {false}};
+    return GetSwitchCache(*switchCache, PROP_SINGLE_DEBUG, false);
 }
 
 bool IsPersistDebugOn()
 {
-    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, false};
-    static atomic_flag isFirstFlag = ATOMIC_FLAG_INIT;
-    bool isFirst = !isFirstFlag.test_and_set();
-    return GetSwitchCache(isFirst, *switchCache, PROP_PERSIST_DEBUG, false);
+    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, {INVALID_GENERATION}, {false}};
+    return GetSwitchCache(*switchCache, PROP_PERSIST_DEBUG, false);
 }
 
 bool IsPrivateSwitchOn()
 {
-    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, true};
-    static atomic_flag isFirstFlag = ATOMIC_FLAG_INIT;
-    bool isFirst = !isFirstFlag.test_and_set();
-    return GetSwitchCache(isFirst, *switchCache, PROP_PRIVATE, true);
+    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, {INVALID_GENERATION}, {true}};
+    return GetSwitchCache(*switchCache, PROP_PRIVATE, true);
 }
 
 bool IsProcessSwitchOn()
 {
-    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, false};
-    static atomic_flag isFirstFlag = ATOMIC_FLAG_INIT;
-    bool isFirst = !isFirstFlag.test_and_set();
-    return GetSwitchCache(isFirst, *switchCache, PROP_PROCESS_FLOWCTRL, false);
+    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, {INVALID_GENERATION}, {false}};
+    return GetSwitchCache(*switchCache, PROP_PROCESS_FLOWCTRL, false);
 }
 
 bool IsDomainSwitchOn()
 {
-    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, false};
-    static atomic_flag isFirstFlag = ATOMIC_FLAG_INIT;
-    bool isFirst = !isFirstFlag.test_and_set();
-    return GetSwitchCache(isFirst, *switchCache, PROP_DOMAIN_FLOWCTRL, false);
+    static SwitchCache *switchCache = new SwitchCache {{nullptr, 0xffffffff, ""}, {INVALID_GENERATION}, {false}};
+    return GetSwitchCache(*switchCache, PROP_DOMAIN_FLOWCTRL, false);
 }
 
 static uint16_t GetCacheLevel(char propertyChar)
@@ -301,97 +337,225 @@ static uint16_t GetCacheLevel(char propertyChar)
     return cacheLevel;
 }
 
+/* caller must hold the lock protecting levelCache */
+static uint16_t RefreshLevelCache(LogLevelCache& levelCache, const string& key, uint32_t generation)
+{
+    RefreshCacheBuf(&levelCache.cache, key.c_str());
+    uint16_t lvl = GetCacheLevel(levelCache.cache.propertyValue[0]);
+    levelCache.logLevel.store(lvl, memory_order_relaxed);
+    levelCache.generation.store(generation, memory_order_release);
+    return lvl;
+}
+
 uint16_t GetGlobalLevel()
 {
+    static LogLevelCache *levelCache = new LogLevelCache{{nullptr, 0xffffffff, ""}, {INVALID_GENERATION},
+        {LOG_LEVEL_MIN}};
+    uint32_t generation = GetGlobalSerial();
+    if (levelCache->generation.load(memory_order_acquire) == generation) {
+        return levelCache->logLevel.load(memory_order_relaxed);
+    }
+
     string key = GetPropertyName(PROP_GLOBAL_LOG_LEVEL);
-    static LogLevelCache *levelCache = new LogLevelCache{{nullptr, 0xffffffff, ""}, LOG_LEVEL_MIN};
-    static atomic_flag isFirstFlag = ATOMIC_FLAG_INIT;
-    int notLocked;
-
-    if (!isFirstFlag.test_and_set() || CheckCache(&levelCache->cache)) {
-        notLocked = LockByProp(PROP_GLOBAL_LOG_LEVEL);
-        if (!notLocked) {
-            RefreshCacheBuf(&levelCache->cache, key.c_str());
-            levelCache->logLevel = GetCacheLevel(levelCache->cache.propertyValue[0]);
-            UnlockByProp(PROP_GLOBAL_LOG_LEVEL);
-            return levelCache->logLevel;
-        } else {
-            LogLevelCache tmpCache = {{nullptr, 0xffffffff, ""}, LOG_LEVEL_MIN};
-            RefreshCacheBuf(&tmpCache.cache, key.c_str());
-            tmpCache.logLevel = GetCacheLevel(tmpCache.cache.propertyValue[0]);
-            return tmpCache.logLevel;
-        }
+    int notLocked = LockByProp(PROP_GLOBAL_LOG_LEVEL);
+    if (!notLocked) {
+        uint16_t lvl = RefreshLevelCache(*levelCache, key, generation);
+        UnlockByProp(PROP_GLOBAL_LOG_LEVEL);
+        return lvl;
     } else {
-        return levelCache->logLevel;
+        PropertyCache tmpCache = {nullptr, 0xffffffff, ""};
+        RefreshCacheBuf(&tmpCache, key.c_str());
+        return GetCacheLevel(tmpCache.propertyValue[0]);
     }
 }
 
-uint16_t GetDomainLevel(uint32_t domain)
+static uint32_t LevelCacheIndex(uint64_t key)
+{
+    return static_cast<uint32_t>((key * LEVEL_CACHE_MULTIPLIER) >> (64 - LEVEL_CACHE_BITS));
+}
+
+/*
+ * Lock-free lookup. A slot is read consistently when its sequence is even and unchanged across
+ * the read; slots are never emptied again, so probing stops at the first never-used slot.
+ */
+static void LevelCacheCount(LevelCacheTable& table, bool hit)
+{
+    LevelCacheCounts& counts = g_levelCacheCounts[table.index];
+    if (hit && ++counts.hits == LEVEL_CACHE_STAT_BATCH) {
+        table.hits.fetch_add(counts.hits, memory_order_relaxed);
+        counts.hits = 0;
+    } else if (!hit && ++counts.misses == LEVEL_CACHE_STAT_BATCH) {
+        table.misses.fetch_add(counts.misses, memory_order_relaxed);
+        counts.misses = 0;
+    }
+}
+
+static void LevelCacheTagWords(const char* tag, uint64_t (&words)[LEVEL_CACHE_TAG_WORDS])
 {
-    static unordered_map<uint32_t, LogLevelCache*> *domainMap = new unordered_map<uint32_t, LogLevelCache*>();
-    unordered_map<uint32_t, LogLevelCache*>::iterator it;
-    string key = GetPropertyName(PROP_DOMAIN_LOG_LEVEL) + to_string(domain);
+    char text[LEVEL_CACHE_TAG_LEN] = {0};
+    (void)strncpy_s(text, LEVEL_CACHE_TAG_LEN, tag, LEVEL_CACHE_TAG_LEN - 1);
+    (void)memcpy_s(words, sizeof(words), text, sizeof(text));
+}
 
-    static shared_timed_mutex* mtx = new shared_timed_mutex;
-    {
-        ReadLock lock(*mtx);
-        it = domainMap->find(domain);
+static bool LevelCacheLookup(LevelCacheTable& table, uint64_t key, const char* tag, uint32_t generation,
+    uint16_t& logLevel)
+{
+    uint32_t pos = LevelCacheIndex(key);
+    uint64_t tagWords[LEVEL_CACHE_TAG_WORDS] = {0};
+    if (tag != nullptr) {
+        LevelCacheTagWords(tag, tagWords);
     }
-    if (it == domainMap->end()) { // new domain
-        InsertLock lock(*mtx);
-        LogLevelCache* levelCache = new LogLevelCache{{nullptr, 0xffffffff, ""}, LOG_LEVEL_MIN};
-        RefreshCacheBuf(&levelCache->cache, key.c_str());
-        levelCache->logLevel = GetCacheLevel(levelCache->cache.propertyValue[0]);
-        uint16_t lvl = levelCache->logLevel;
-        pair<unordered_map<uint32_t, LogLevelCache*>::iterator, bool> ret = domainMap->insert({ domain, levelCache });
-        if (!ret.second) {
-            delete levelCache;
-            levelCache = nullptr;
+    for (uint32_t i = 0; i < LEVEL_CACHE_PROBE; i++) {
+        LevelCacheSlot& slot = table.slots[(pos + i) & (LEVEL_CACHE_SIZE - 1)];
+        uint32_t seq = slot.seq.load(memory_order_acquire);
+        if (seq == 0) {
+            break;
         }
-        return lvl;
-    } else { // existed domain
-        if (CheckCache(&it->second->cache)) { // changed
-            InsertLock lock(*mtx);
-            RefreshCacheBuf(&it->second->cache, key.c_str());
-            it->second->logLevel = GetCacheLevel(it->second->cache.propertyValue[0]);
-            return it->second->logLevel;
-        } else { // not changed
-            return it->second->logLevel;
+        if ((seq & 1) != 0) {
+            continue;
+        }
+        uint64_t slotKey = slot.key.load(memory_order_relaxed);
+        uint32_t slotGeneration = slot.generation.load(memory_order_relaxed);
+        uint16_t lvl = slot.logLevel.load(memory_order_relaxed);
+        uint64_t slotTag[LEVEL_CACHE_TAG_WORDS] = {0};
+        for (uint32_t w = 0; tag != nullptr && w < LEVEL_CACHE_TAG_WORDS; w++) {
+            slotTag[w] = slot.tag[w].load(memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (slot.seq.load(memory_order_relaxed) != seq || slotKey != key) {
+            continue;
         }
+        if (tag != nullptr && memcmp(slotTag, tagWords, sizeof(tagWords)) != 0) {
+            continue;
+        }
+        if (slotGeneration != generation) {
+            break;
+        }
+        if (!slot.referenced.load(memory_order_relaxed)) {
+            slot.referenced.store(true, memory_order_relaxed);
+        }
+        LevelCacheCount(table, true);
+        logLevel = lvl;
+        return true;
     }
+    LevelCacheCount(table, false);
+    return false;
 }
 
-uint16_t GetTagLevel(const string& tag)
+static void LevelCacheUpdate(LevelCacheTable& table, uint64_t key, const char* tag, uint32_t generation,
+    uint16_t logLevel)
 {
-    static unordered_map<string, LogLevelCache*> *tagMap = new unordered_map<string, LogLevelCache*>();
-    unordered_map<string, LogLevelCache*>::iterator it;
-    string key = GetPropertyName(PROP_TAG_LOG_LEVEL) + tag;
-
-    static shared_timed_mutex* mtx = new shared_timed_mutex;
-    {
-        ReadLock lock(*mtx);
-        it = tagMap->find(tag);
+    lock_guard<mutex> lock(table.writeLock);
+    uint32_t pos = LevelCacheIndex(key);
+    LevelCacheSlot* victim = nullptr;
+    for (uint32_t i = 0; i < LEVEL_CACHE_PROBE; i++) {
+        LevelCacheSlot& slot = table.slots[(pos + i) & (LEVEL_CACHE_SIZE - 1)];
+        if (slot.seq.load(memory_order_relaxed) == 0 || slot.key.load(memory_order_relaxed) == key) {
+            victim = &slot;
+            break;
+        }
     }
-    if (it == tagMap->end()) { // new tag
-        InsertLock lock(*mtx);
-        LogLevelCache* levelCache = new LogLevelCache{{nullptr, 0xffffffff, ""}, LOG_LEVEL_MIN};
-        RefreshCacheBuf(&levelCache->cache, key.c_str());
-        levelCache->logLevel = GetCacheLevel(levelCache->cache.propertyValue[0]);
-        uint16_t lvl = levelCache->logLevel;
-        pair<unordered_map<string, LogLevelCache*>::iterator, bool> ret = tagMap->insert({ tag, levelCache });
-        if (!ret.second) {
-            delete(levelCache);
-            levelCache = nullptr;
+    // CLOCK: give referenced slots a second chance, ends within two sweeps of the probe window
+    while (victim == nullptr) {
+        LevelCacheSlot& slot = table.slots[(pos + table.clockHand % LEVEL_CACHE_PROBE) & (LEVEL_CACHE_SIZE - 1)];
+        table.clockHand++;
+        if (!slot.referenced.exchange(false, memory_order_relaxed)) {
+            victim = &slot;
+            table.evictions.fetch_add(1, memory_order_relaxed);
         }
-        return lvl;
-    } else { // existed tag
-        if (CheckCache(&it->second->cache)) { // changed
-            InsertLock lock(*mtx);
-            RefreshCacheBuf(&it->second->cache, key.c_str());
-            it->second->logLevel = GetCacheLevel(it->second->cache.propertyValue[0]);
-            return it->second->logLevel;
-        } else { // not changed
-            return it->second->logLevel;
+    }
+
+    uint32_t seq = victim->seq.load(memory_order_relaxed);
+    victim->seq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    victim->key.store(key, memory_order_relaxed);
+    victim->generation.store(generation, memory_order_relaxed);
+    victim->logLevel.store(logLevel, memory_order_relaxed);
+    if (tag != nullptr) {
+        uint64_t tagWords[LEVEL_CACHE_TAG_WORDS] = {0};
+        LevelCacheTagWords(tag, tagWords);
+        for (uint32_t w = 0; w < LEVEL_CACHE_TAG_WORDS; w++) {
+            victim->tag[w].store(tagWords[w], memory_order_relaxed);
         }
     }
-}
\ No newline at end of file
+    victim->referenced.store(true, memory_order_relaxed);
+    victim->seq.store(seq + 2, memory_order_release);
+}
+
+/* what threads have counted but not added to the table yet is left out, LEVEL_CACHE_STAT_BATCH at most each */
+static void FillLevelCacheStats(const LevelCacheTable& table, LevelCacheStats& stats)
+{
+    stats.hits = table.hits.load(memory_order_relaxed);
+    stats.misses = table.misses.load(memory_order_relaxed);
+    stats.evictions = table.evictions.load(memory_order_relaxed);
+}
+
+static LevelCacheTable& GetDomainLevelCache()
+{
+    static LevelCacheTable *domainCache = [] {
+        LevelCacheTable *table = new LevelCacheTable();
+        table->index = 0;
+        return table;
+    }();
+    return *domainCache;
+}
+
+static LevelCacheTable& GetTagLevelCache()
+{
+    static LevelCacheTable *tagCache = [] {
+        LevelCacheTable *table = new LevelCacheTable();
+        table->index = 1;
+        return table;
+    }();
+    return *tagCache;
+}
+
+static uint16_t GetPropertyLevel(const string& key)
+{
+    PropertyCache tmpCache = {nullptr, 0xffffffff, ""};
+    RefreshCacheBuf(&tmpCache, key.c_str());
+    return GetCacheLevel(tmpCache.propertyValue[0]);
+}
+
+uint16_t GetDomainLevel(uint32_t domain)
+{
+    uint32_t generation = GetGlobalSerial();
+    uint16_t lvl = LOG_LEVEL_MIN;
+    if (LevelCacheLookup(GetDomainLevelCache(), domain, nullptr, generation, lvl)) {
+        return lvl;
+    }
+    lvl = GetPropertyLevel(GetPropertyName(PROP_DOMAIN_LOG_LEVEL) + to_string(domain));
+    LevelCacheUpdate(GetDomainLevelCache(), domain, nullptr, generation, lvl);
+    return lvl;
+}
+
+uint16_t GetTagLevel(const string& tag)
+{
+    uint64_t tagHash = LEVEL_CACHE_HASH_BASIS;
+    for (char c : tag) {
+        tagHash ^= static_cast<unsigned char>(c);
+        tagHash *= LEVEL_CACHE_HASH_PRIME;
+    }
+    uint32_t generation = GetGlobalSerial();
+    uint16_t lvl = LOG_LEVEL_MIN;
+    if (tag.length() >= LEVEL_CACHE_TAG_LEN) {
+        /* longer than a slot keeps, not cached */
+        return GetPropertyLevel(GetPropertyName(PROP_TAG_LOG_LEVEL) + tag);
+    }
+    if (LevelCacheLookup(GetTagLevelCache(), tagHash, tag.c_str(), generation, lvl)) {
+        return lvl;
+    }
+    lvl = GetPropertyLevel(GetPropertyName(PROP_TAG_LOG_LEVEL) + tag);
+    LevelCacheUpdate(GetTagLevelCache(), tagHash, tag.c_str(), generation, lvl);
+    return lvl;
+}
+
+void GetDomainLevelCacheStats(LevelCacheStats& stats)
+{
+    FillLevelCacheStats(GetDomainLevelCache(), stats);
+}
+
+void GetTagLevelCacheStats(LevelCacheStats& stats)
+{
+    FillLevelCacheStats(GetTagLevelCache(), stats);
+}
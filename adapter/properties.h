@@ -33,6 +33,12 @@ using PropType = enum {
     PROP_PERSIST_DEBUG,
 };
 
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} LevelCacheStats;
+
 std::string GetPropertyName(uint32_t propType);
 std::string GetProgName();
 uint16_t GetTagLevel(const std::string& tag);
@@ -46,5 +52,7 @@ bool IsProcessSwitchOn();
 bool IsDomainSwitchOn();
 uint16_t GetGlobalLevel();
 uint16_t GetDomainLevel(uint32_t domain);
+void GetDomainLevelCacheStats(LevelCacheStats& stats);
+void GetTagLevelCacheStats(LevelCacheStats& stats);
 
 #endif
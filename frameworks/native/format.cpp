@@ -119,12 +119,12 @@ int HilogShowTimeBuffer(char* buffer, int bufLen, HilogShowFormat showFormat,
     return timeLen;
 }
 
-void HilogShowBuffer(char* buffer, int bufLen, const HilogShowFormatBuffer& contentOut, HilogShowFormat showFormat)
+int HilogShowHeader(char* buffer, int bufLen, const HilogShowFormatBuffer& contentOut, HilogShowFormat showFormat)
 {
     int logLen = 0;
     int ret = 0;
     if (buffer == nullptr) {
-        return;
+        return 0;
     }
     logLen += HilogShowTimeBuffer(buffer, bufLen, showFormat, contentOut);
 
@@ -142,9 +142,6 @@ void HilogShowBuffer(char* buffer, int bufLen, const HilogShowFormatBuffer& cont
             "\x1B[38;5;%dm%05x/%s:\x1b[0m", ColorFromLevel(contentOut.level),
             contentOut.domain & 0xFFFFF, contentOut.data);
         logLen += ((ret > 0) ? ret : 0);
-        ret = snprintf_s(buffer + logLen, bufLen - logLen, bufLen - logLen - 1,
-            " \x1B[38;5;%dm%s\x1b[0m", ColorFromLevel(contentOut.level), contentOut.data + contentOut.tag_len);
-        logLen += ((ret > 0) ? ret : 0);
     } else {
         ret = snprintf_s(buffer + logLen, bufLen - logLen, bufLen - logLen - 1,
             " %5d", contentOut.pid);
@@ -158,9 +155,24 @@ void HilogShowBuffer(char* buffer, int bufLen, const HilogShowFormatBuffer& cont
         ret = snprintf_s(buffer + logLen, bufLen - logLen, bufLen - logLen - 1,
             "%05x/%s:", contentOut.domain & 0xFFFFF, contentOut.data);
         logLen += ((ret > 0) ? ret : 0);
-        ret = snprintf_s(buffer + logLen, bufLen - logLen, bufLen - logLen - 1,
+    }
+    return logLen;
+}
+
+void HilogShowBuffer(char* buffer, int bufLen, const HilogShowFormatBuffer& contentOut, HilogShowFormat showFormat)
+{
+    int logLen = 0;
+    if (buffer == nullptr) {
+        return;
+    }
+    logLen += HilogShowHeader(buffer, bufLen, contentOut, showFormat);
+
+    if (showFormat == COLOR_SHOWFORMAT) {
+        (void)snprintf_s(buffer + logLen, bufLen - logLen, bufLen - logLen - 1,
+            " \x1B[38;5;%dm%s\x1b[0m", ColorFromLevel(contentOut.level), contentOut.data + contentOut.tag_len);
+    } else {
+        (void)snprintf_s(buffer + logLen, bufLen - logLen, bufLen - logLen - 1,
             " %s", contentOut.data + contentOut.tag_len);
-        logLen += ((ret > 0) ? ret : 0);
     }
 }
 }
@@ -36,6 +36,8 @@ static RegisterFunc g_registerFunc = nullptr;
 static atomic_int g_hiLogGetIdCallCount = 0;
 static const long long NSEC_PER_SEC = 1000000000ULL;
 static const char P_LIMIT_TAG[] = "LOGLIMITP";
+static const char P_CACHE_TAG[] = "LOGCACHEP";
+static const uint32_t CACHE_REPORT_LINES = 65536;
 #ifdef DEBUG
 static const int MAX_PATH_LEN = 1024;
 #endif
@@ -167,6 +169,28 @@ static int HiLogFlowCtrlProcess(int len, uint16_t logType, bool debug)
     return 0;
 }
 
+/* level caches live in each process, with debug on their counters are logged every CACHE_REPORT_LINES lines */
+static void HiLogReportLevelCache(HilogMsg& header)
+{
+    static thread_local uint32_t lines = 0;
+    if (++lines < CACHE_REPORT_LINES) {
+        return;
+    }
+    lines = 0;
+    LevelCacheStats domainStats = {};
+    LevelCacheStats tagStats = {};
+    GetDomainLevelCacheStats(domainStats);
+    GetTagLevelCacheStats(tagStats);
+    char cacheLogBuf[MAX_LOG_LEN] = {0};
+    (void)snprintf_s(cacheLogBuf, MAX_LOG_LEN, MAX_LOG_LEN - 1,
+        "level cache domain hits %llu misses %llu evictions %llu, tag hits %llu misses %llu evictions %llu",
+        (unsigned long long)domainStats.hits, (unsigned long long)domainStats.misses,
+        (unsigned long long)domainStats.evictions, (unsigned long long)tagStats.hits,
+        (unsigned long long)tagStats.misses, (unsigned long long)tagStats.evictions);
+    HilogWriteLogMessage(&header, P_CACHE_TAG, strlen(P_CACHE_TAG) + 1, cacheLogBuf,
+                         strnlen(cacheLogBuf, MAX_LOG_LEN - 1) + 1);
+}
+
 #ifdef DEBUG
 static size_t GetExecutablePath(char *processdir, char *processname, size_t len)
 {
@@ -269,6 +293,9 @@ int HiLogPrintArgs(const LogType type, const LogLevel level, const unsigned int
         HilogWriteLogMessage(&header, P_LIMIT_TAG, strlen(P_LIMIT_TAG) + 1, dropLogBuf,
                              strnlen(dropLogBuf, MAX_LOG_LEN - 1) + 1);
     }
+    if (debug) {
+        HiLogReportLevelCache(header);
+    }
 
     return HilogWriteLogMessage(&header, tag, tagLen + 1, buf, logLen + 1);
 }
@@ -21,6 +21,8 @@ namespace OHOS {
 namespace HiviewDFX {
 const char* ParsedFromLevel(uint16_t level);
 int ColorFromLevel(uint16_t level);
+/* everything of a shown line up to and including "domain/tag:", returns its length */
+int HilogShowHeader(char* buffer, int bufLen, const HilogShowFormatBuffer& contentOut, HilogShowFormat showFormat);
 void HilogShowBuffer(char* buffer, int bufLen, const HilogShowFormatBuffer& contentOut, HilogShowFormat showFormat);
 } // namespace HiviewDFX
 } // namespace OHOS
@@ -122,5 +122,8 @@ typedef enum {
     ERR_FLOWCTRL_SWITCH_VALUE_INVALID = -29,
     ERR_BUFF_SIZE_INVALID = -30,
     ERR_COMMAND_INVALID = -31,
+    ERR_LOG_PERSIST_FILE_FORMAT_INVALID = -32,
+    ERR_LOG_PERSIST_SYNC_MODE_INVALID = -33,
+    ERR_QUERY_QUEUE_INVALID = -34,
 } ErrorCode;
 #endif /* HILOG_COMMON_H */
@@ -16,6 +16,7 @@
 #ifndef HILOGTOOL_MSG_H
 #define HILOGTOOL_MSG_H
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <stdint.h>
@@ -24,6 +25,21 @@
 
 #define FILE_PATH_MAX_LEN 100
 #define JOB_ID_ALL 0xffffffff
+/* MessageHeader::version of a log query in which hilogd pushes records as long as the client gives credit */
+#define LOG_QUERY_VERSION_STREAM 1
+/* bytes of responses a streaming client lets hilogd send ahead, it pays them back in LogQueryCredit */
+#define LOG_QUERY_CREDIT_WINDOW (256 * 1024)
+/* MessageHeader::version of a streaming log query in which hilogd packs the records into LogQueryFrame */
+#define LOG_QUERY_VERSION_BATCH 2
+/* most bytes of a LogQueryFrame, header included, it has to fit MessageHeader::msgLen */
+#define LOG_QUERY_FRAME_LEN (60 * 1024)
+/* bytes a record takes in a LogQueryFrame, every record starts 4 byte aligned */
+#define LOG_QUERY_RECORD_LEN(length) ((sizeof(HilogDataMessage) + (length) + 3) & ~(size_t)3)
+/* MessageHeader::version of the responses of a batched log query whose regex hilogd has applied */
+#define LOG_QUERY_VERSION_FILTER 3
+#define MAX_QUERY_REGEX_LEN 256 /* include '\0' */
+/* MessageHeader::version of a log query whose client takes LogQueryLoss among the responses */
+#define LOG_QUERY_VERSION_LOSS 4
 typedef enum {
     LOG_QUERY_REQUEST = 0x01,
     LOG_QUERY_RESPONSE,
@@ -47,7 +63,10 @@ typedef enum {
     MC_REQ_FLOW_CONTROL,         // set flow control request
     MC_RSP_FLOW_CONTROL,         // set flow control response
     MC_REQ_LOG_CLEAR,            // clear log request
-    MC_RSP_LOG_CLEAR             // clear log response
+    MC_RSP_LOG_CLEAR,            // clear log response
+    LOG_QUERY_CREDIT,            // more credit for a streaming log query
+    LOG_QUERY_FRAME,             // records of a batched log query
+    LOG_QUERY_LOSS,              // lines a log query lost
 } OperationCmd;
 
 /*
@@ -76,6 +95,13 @@ typedef enum {
     COMPRESS_TYPE_ZLIB,
 } CompressAlg;
 
+/* what goes when more records wait for a log query than its queue holds */
+typedef enum {
+    QUEUE_DROP_OLDEST = 0,
+    QUEUE_DROP_NEWEST,
+    QUEUE_DISCONNECT,
+} QueueDropPolicy;
+
 typedef enum {
     OFF_SHOWFORMAT = 0,
     COLOR_SHOWFORMAT,
@@ -113,6 +139,15 @@ typedef struct {
     uint32_t noPids[MAX_PIDS];
     uint32_t noDomains[MAX_DOMAINS];
     char noTags[MAX_TAGS][MAX_TAG_LEN];
+    uint32_t credit; /* bytes of responses hilogd may send right away, LOG_QUERY_VERSION_STREAM only */
+    char regex[MAX_QUERY_REGEX_LEN]; /* -e pattern for hilogd to match, LOG_QUERY_VERSION_FILTER only */
+    uint64_t beginTime; /* nanoseconds since the epoch, the records of the range only */
+    uint64_t endTime;
+    uint16_t headLines; /* the first or the last records only, 0 for all of them */
+    uint16_t tailLines;
+    uint32_t queueLines; /* records that came in after the query started and wait for it, 0 for no limit */
+    uint8_t dropPolicy; /* QueueDropPolicy */
+    uint8_t snapshot; /* 1 for the records there are when the query starts only, as -x reads */
 } LogQueryRequest;
 
 typedef struct {
@@ -134,6 +169,23 @@ typedef struct {
     HilogDataMessage data;
 } LogQueryResponse;
 
+/* header.msgLen is the length of the whole frame, the records follow one after another up to it */
+typedef struct {
+    MessageHeader header;
+    char records[];
+} LogQueryFrame;
+
+typedef struct {
+    MessageHeader header;
+    uint32_t credit; /* bytes of responses the client has taken in since it last gave credit */
+} LogQueryCredit;
+
+/* sent in place of the lines, in the order of the records, LOG_QUERY_VERSION_LOSS only */
+typedef struct {
+    MessageHeader header;
+    uint32_t lines; /* records that matched the query but were dropped before they were sent */
+} LogQueryLoss;
+
 typedef struct {
     MessageHeader header;
 } NewDataNotify;
@@ -245,6 +297,8 @@ typedef struct {
     std::string fileNumStr;
     std::string fileNameStr;
     std::string jobIdStr;
+    std::string fileFormatStr;
+    std::string syncModeStr;
 } LogPersistParam;
 typedef struct {
     uint16_t logType; // union logType
@@ -253,7 +307,11 @@ typedef struct {
     uint32_t fileSize;
     uint32_t fileNum;
     uint32_t jobId;
+    uint16_t fileFormat; /* PersistFileFormat */
+    uint16_t syncMode; /* PersistSyncMode */
 } LogPersistStartMsg;
+/* a hilogtool from before fileFormat and syncMode sends the message up to them */
+#define PERSIST_START_MSG_V1_LEN offsetof(LogPersistStartMsg, fileFormat)
 typedef struct {
     MessageHeader msgHeader;
     LogPersistStartMsg logPersistStartMsg;
@@ -302,6 +360,8 @@ typedef struct {
     char filePath[FILE_PATH_MAX_LEN];
     uint32_t fileSize;
     uint32_t fileNum;
+    uint16_t fileFormat;
+    uint16_t syncMode;
 } LogPersistQueryResult;
 typedef struct {
     MessageHeader msgHeader;
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PERSIST_FORMAT_H
+#define PERSIST_FORMAT_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "hilog_common.h"
+/*
+ * Binary persist file layout (PERSIST_FORMAT_BINARY), before compression:
+ *
+ *   file   := PersistFileHeader block*
+ *   block  := PERSIST_BLOCK_START record*
+ *   record := kind varint(tagRef) [varint(tagLen) tag] varint(zigzag(timeDelta))
+ *             varint(pid) varint(tid) varint(domain) varint(contentLen) content
+ *
+ * kind holds level in bits 0-2 and type in bits 3-6, bit 7 marks control bytes.
+ * A block resets the tag table and the time base, so it decodes without anything before it.
+ * tagRef 0 means the tag follows inline and takes the next table index while fewer than
+ * PERSIST_MAX_TAGS are interned, tagRef n refers to index n - 1.
+ * timeDelta is in nanoseconds against the previous record of the block, the first one counts from 0.
+ * content has no '\0' and may span several lines.
+ *
+ * A file, binary or text, is compressed as one gzip member or zstd frame that is ended when
+ * the file is rotated. Every block ends at a sync flush point of it and is listed in the sidecar
+ * index "<file>.idx":
+ *
+ *   index  := PersistIndexHeader PersistIndexEntry*
+ *
+ * Entries are appended as blocks reach the file, a torn last entry is to be ignored. The blocks
+ * of a compressed file follow each other after the file header once decompressed, an entry tells
+ * whether a block is worth decoding and how long it is, and where the stream can stop.
+ *
+ * A job writes file number seq to "<path>.<seq % fileNum>", so rotating only replaces the
+ * oldest file. "<path>.manifest" lists the live files oldest first, one "<seq> <name>" line
+ * each, with name relative to the directory of the manifest.
+ */
+namespace OHOS {
+namespace HiviewDFX {
+#define PERSIST_MAGIC "HLGB"
+#define PERSIST_MAGIC_LEN 4
+#define PERSIST_INDEX_MAGIC "HLGI"
+#define PERSIST_INDEX_SUFFIX ".idx"
+#define PERSIST_MANIFEST_SUFFIX ".manifest"
+const uint16_t PERSIST_SCHEMA_VERSION = 1;
+const uint8_t PERSIST_BLOCK_START = 0x80;
+const uint32_t PERSIST_MAX_TAGS = 256;
+const uint32_t MAX_VARINT_LEN = 10;
+/* worst case size of one encoded record, a block must always be able to take it */
+const uint32_t MAX_PERSIST_RECORD_LEN = 1 + MAX_VARINT_LEN * 7 + MAX_TAG_LEN + MAX_LOG_LEN;
+
+typedef struct {
+    char magic[PERSIST_MAGIC_LEN];
+    uint16_t version;
+    uint16_t headerLen; /* sizeof the header as written, newer versions may append fields */
+} PersistFileHeader;
+
+typedef struct {
+    char magic[PERSIST_MAGIC_LEN];
+    uint16_t version;
+    uint16_t entryLen; /* sizeof each entry as written */
+} PersistIndexHeader;
+
+typedef struct {
+    uint64_t offset;     /* of the block in the log file */
+    uint32_t length;     /* compressed length */
+    uint32_t records;
+    uint64_t minTime;    /* nanoseconds since epoch */
+    uint64_t maxTime;
+    uint64_t pidBits;    /* PersistPidBit() of every pid in the block */
+    uint64_t domainBits; /* PersistDomainBit() of every domain in the block */
+    uint16_t types;      /* 1 << type */
+    uint8_t levels;      /* 1 << level */
+    uint8_t reserved;
+    uint32_t plainLength;
+} PersistIndexEntry;
+
+typedef struct {
+    uint32_t seq;
+    std::string name;
+} PersistManifestEntry;
+
+typedef enum {
+    PERSIST_FORMAT_TEXT = 0,
+    PERSIST_FORMAT_BINARY,
+} PersistFileFormat;
+
+/* how hard a persist job pushes its files to storage, see LogPersisterRotator::SyncOutput */
+typedef enum {
+    PERSIST_SYNC_NONE = 0, /* leave it to the kernel writeback, a crash may lose what it had not written */
+    PERSIST_SYNC_PERIODIC, /* fdatasync every PERSIST_SYNC_INTERVAL_MS or PERSIST_SYNC_BYTES */
+    PERSIST_SYNC_ALWAYS,   /* fdatasync every block before taking the next one */
+} PersistSyncMode;
+const uint32_t PERSIST_SYNC_INTERVAL_MS = 1000;
+const uint32_t PERSIST_SYNC_BYTES = 1024 * 1024;
+
+void InitPersistFileHeader(PersistFileHeader &header);
+void InitPersistIndexHeader(PersistIndexHeader &header);
+/* an entry that matches no query, records are added with PersistIndexAdd */
+void PersistIndexReset(PersistIndexEntry &entry);
+/* an entry that matches every query, for blocks whose content is unknown */
+void PersistIndexSetUnknown(PersistIndexEntry &entry);
+void PersistIndexAdd(PersistIndexEntry &entry, uint64_t time, uint32_t pid, uint32_t domain,
+    uint16_t type, uint16_t level);
+int32_t ReadPersistManifest(const std::string &path, std::vector<PersistManifestEntry> &files);
+/* returns bytes written to dest, which must have MAX_VARINT_LEN bytes of room */
+uint32_t PutVarint(char *dest, uint64_t value);
+/* returns bytes consumed, 0 if src[0, len) ends within the varint or it is too long */
+uint32_t GetVarint(const char *src, uint32_t len, uint64_t &value);
+/* CRC32C (Castagnoli) of data[0, len) continuing from crc, 0 to start; uses the CPU CRC instructions if it has them */
+uint32_t PersistCrc32c(uint32_t crc, const char *data, size_t len);
+inline uint64_t PersistPidBit(uint32_t pid)
+{
+    return 1ULL << (pid % 64);
+}
+inline uint64_t PersistDomainBit(uint32_t domain)
+{
+    return 1ULL << ((domain * 0x9E3779B1U) >> 26);
+}
+inline uint64_t ZigZagEncode(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+inline int64_t ZigZagDecode(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif /* PERSIST_FORMAT_H */
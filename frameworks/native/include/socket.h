@@ -37,6 +37,7 @@ public:
     int WriteV(iovec *vec, unsigned int len);
     int Read(char *buffer, unsigned int len);
     int Recv(void *buffer, unsigned int bufferLen, int flags = MSG_PEEK);
+    int GetHandler() const;
 protected:
     int socketHandler = 0;
     uint32_t socketType;
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "persist_format.h"
+
+#include <fstream>
+#include <securec.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace OHOS {
+namespace HiviewDFX {
+static const uint8_t VARINT_MORE = 0x80;
+static const uint8_t VARINT_BITS = 7;
+static const uint32_t CRC32C_POLY = 0x82F63B78; /* reflected */
+
+void InitPersistFileHeader(PersistFileHeader &header)
+{
+    (void)memset_s(&header, sizeof(header), 0, sizeof(header));
+    (void)memcpy_s(header.magic, PERSIST_MAGIC_LEN, PERSIST_MAGIC, PERSIST_MAGIC_LEN);
+    header.version = PERSIST_SCHEMA_VERSION;
+    header.headerLen = sizeof(PersistFileHeader);
+}
+
+void InitPersistIndexHeader(PersistIndexHeader &header)
+{
+    (void)memset_s(&header, sizeof(header), 0, sizeof(header));
+    (void)memcpy_s(header.magic, PERSIST_MAGIC_LEN, PERSIST_INDEX_MAGIC, PERSIST_MAGIC_LEN);
+    header.version = PERSIST_SCHEMA_VERSION;
+    header.entryLen = sizeof(PersistIndexEntry);
+}
+
+void PersistIndexReset(PersistIndexEntry &entry)
+{
+    (void)memset_s(&entry, sizeof(entry), 0, sizeof(entry));
+    entry.minTime = UINT64_MAX;
+}
+
+void PersistIndexSetUnknown(PersistIndexEntry &entry)
+{
+    entry.minTime = 0;
+    entry.maxTime = UINT64_MAX;
+    entry.pidBits = UINT64_MAX;
+    entry.domainBits = UINT64_MAX;
+    entry.types = UINT16_MAX;
+    entry.levels = UINT8_MAX;
+}
+
+void PersistIndexAdd(PersistIndexEntry &entry, uint64_t time, uint32_t pid, uint32_t domain,
+    uint16_t type, uint16_t level)
+{
+    entry.records++;
+    entry.minTime = (time < entry.minTime) ? time : entry.minTime;
+    entry.maxTime = (time > entry.maxTime) ? time : entry.maxTime;
+    entry.pidBits |= PersistPidBit(pid);
+    entry.domainBits |= PersistDomainBit(domain);
+    entry.types |= 1 << type;
+    entry.levels |= 1 << level;
+}
+
+int32_t ReadPersistManifest(const std::string &path, std::vector<PersistManifestEntry> &files)
+{
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        return RET_FAIL;
+    }
+    files.clear();
+    PersistManifestEntry entry;
+    while (in >> entry.seq >> entry.name) {
+        files.push_back(entry);
+    }
+    return RET_SUCCESS;
+}
+
+uint32_t PutVarint(char *dest, uint64_t value)
+{
+    uint32_t len = 0;
+    while (value >= VARINT_MORE) {
+        dest[len++] = static_cast<char>((value & (VARINT_MORE - 1)) | VARINT_MORE);
+        value >>= VARINT_BITS;
+    }
+    dest[len++] = static_cast<char>(value);
+    return len;
+}
+
+uint32_t GetVarint(const char *src, uint32_t len, uint64_t &value)
+{
+    value = 0;
+    for (uint32_t i = 0; i < len && i < MAX_VARINT_LEN; i++) {
+        uint8_t byte = static_cast<uint8_t>(src[i]);
+        value |= static_cast<uint64_t>(byte & (VARINT_MORE - 1)) << (VARINT_BITS * i);
+        if ((byte & VARINT_MORE) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+static uint32_t Crc32cSoft(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static uint32_t table[256];
+    static bool tableReady = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value >> 1) ^ ((value & 1) ? CRC32C_POLY : 0);
+            }
+            table[i] = value;
+        }
+        return true;
+    }();
+    (void)tableReady;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static uint32_t Crc32cHard(uint32_t crc, const uint8_t *data, size_t len)
+{
+    uint64_t value = crc;
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+        uint64_t word;
+        (void)memcpy_s(&word, sizeof(word), data, sizeof(word));
+        value = _mm_crc32_u64(value, word);
+    }
+    crc = static_cast<uint32_t>(value);
+    for (; len > 0; len--, data++) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+
+static bool HasCrc32c()
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__aarch64__)
+#ifdef __clang__
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+static uint32_t Crc32cHard(uint32_t crc, const uint8_t *data, size_t len)
+{
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+        uint64_t word;
+        (void)memcpy_s(&word, sizeof(word), data, sizeof(word));
+        crc = __crc32cd(crc, word);
+    }
+    for (; len > 0; len--, data++) {
+        crc = __crc32cb(crc, *data);
+    }
+    return crc;
+}
+
+static bool HasCrc32c()
+{
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#else
+static uint32_t Crc32cHard(uint32_t crc, const uint8_t *data, size_t len)
+{
+    return Crc32cSoft(crc, data, len);
+}
+
+static bool HasCrc32c()
+{
+    return false;
+}
+#endif
+
+uint32_t PersistCrc32c(uint32_t crc, const char *data, size_t len)
+{
+    static const bool hard = HasCrc32c();
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    crc = ~crc;
+    crc = hard ? Crc32cHard(crc, bytes, len) : Crc32cSoft(crc, bytes, len);
+    return ~crc;
+}
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -106,6 +106,11 @@ int Socket::Read(char *buffer, unsigned int len)
     return TEMP_FAILURE_RETRY(read(socketHandler, buffer, len));
 }
 
+int Socket::GetHandler() const
+{
+    return socketHandler;
+}
+
 int Socket::Recv(void *buffer, unsigned int bufferLen, int flags)
 {
     return TEMP_FAILURE_RETRY(recv(socketHandler, buffer, bufferLen, flags));
@@ -14,12 +14,12 @@
  */
 #include "cmd_executor.h"
 #include "log_querier.h"
+#include "log_querier_reactor.h"
 #include "seq_packet_socket_server.h"
 
 #include <iostream>
 #include <memory>
 #include <sys/stat.h>
-#include <thread>
 #include <unistd.h>
 
 namespace OHOS {
@@ -28,18 +28,9 @@ const int MAX_WRITE_LOG_TASK = 100;
 
 using namespace std;
 HilogBuffer* CmdExecutor::hilogBuffer = nullptr;
-void LogQuerierMonitor(std::unique_ptr<Socket> handler)
-{
-    std::shared_ptr<LogQuerier> logQuerier = std::make_shared<LogQuerier>(std::move(handler),
-        CmdExecutor::getHilogBuffer());
-    logQuerier->LogQuerierThreadFunc(logQuerier);
-}
-
 int CmdExecutorThreadFunc(std::unique_ptr<Socket> handler)
 {
-    std::thread logQuerierMonitorThread(LogQuerierMonitor, std::move(handler));
-    logQuerierMonitorThread.detach();
-    return 0;
+    return LogQuerierReactor::GetInstance().Add(std::move(handler), CmdExecutor::getHilogBuffer());
 }
 
 CmdExecutor::CmdExecutor(HilogBuffer* buffer)
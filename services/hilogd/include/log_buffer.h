@@ -16,6 +16,7 @@
 #ifndef LOG_BUFFER_H
 #define LOG_BUFFER_H
 
+#include <atomic>
 #include <cstdint>
 #include <list>
 #include <map>
@@ -28,6 +29,9 @@
 
 namespace OHOS {
 namespace HiviewDFX {
+const uint32_t TIME_INDEX_STRIDE = 256;
+const size_t MAX_PINNED_BYTES = 1048576; /* a snapshot query keeps no more than this let go for it */
+
 class HilogBuffer {
 public:
     HilogBuffer();
@@ -50,18 +54,62 @@ public:
     void GetBufferLock();
     void ReleaseBufferLock();
 private:
+    /*
+     * The list, the sizes, the cache lengths, the time index and the positions of the readers change
+     * with the lock held for writing only, readers walk the list with it shared. Insert copies the
+     * record before it takes the lock, so a writer holds it no longer than it takes to link a node in.
+     */
     size_t size;
     size_t sizeByType[LOG_TYPE_MAX];
     std::list<HilogData> hilogDataList;
+    /* records let go that snapshot queries still have to read, by type in the order of hilogDataList */
+    std::list<HilogData> pinnedList[LOG_TYPE_MAX];
     std::shared_mutex hilogBufferMutex;
+    std::mutex statisticMutex; /* the print lengths, readers count what they print at the same time */
     std::map<uint32_t, uint64_t> cacheLenByDomain;
     std::map<uint32_t, uint64_t> printLenByDomain;
     std::map<uint32_t, uint64_t> droppedByDomain;
     uint64_t cacheLenByType[LOG_TYPE_MAX];
     uint64_t droppedByType[LOG_TYPE_MAX];
     uint64_t printLenByType[LOG_TYPE_MAX];
-    bool ConditionMatch(std::shared_ptr<LogReader> reader);
+    /*
+     * The list is kept sorted by tv_sec, so every TIME_INDEX_STRIDE-th record appended is enough to
+     * find where a second starts with a binary search and a short walk.
+     */
+    struct TimeIndexEntry {
+        uint32_t tv_sec;
+        std::list<HilogData>::iterator pos;
+    };
+    std::vector<TimeIndexEntry> timeIndex;
+    uint32_t sinceIndexed = 0;
+    std::atomic<uint64_t> nextSeq {0};
+    uint32_t evictEpoch = 0; /* counts the evictions, records let go are stamped with it */
+    std::vector<std::shared_ptr<LogReader>> queueReaders; /* the queries with queueLines, Insert counts for them */
+    uint16_t queueMasks = 0; /* the bits of HilogData::wanted they use */
+    bool ConditionMatch(const std::shared_ptr<LogReader> &reader, std::list<HilogData>::iterator pos);
+    void CountQueued(std::list<HilogData>::iterator pos);
+    void MarkWanted(const std::shared_ptr<LogReader> &reader);
+    bool Wanted(const std::shared_ptr<LogReader> &reader, std::list<HilogData>::iterator pos);
     void ReturnNoLog(std::shared_ptr<LogReader> reader);
+    void CountPrinted(const HilogData &data);
+    bool TrimQueue(std::shared_ptr<LogReader> reader);
+    bool Pinned(std::shared_ptr<LogReader> reader, std::list<HilogData>::iterator pos);
+    void Unpin(std::shared_ptr<LogReader> reader);
+    void CutPins(std::shared_ptr<LogReader> reader);
+    uint16_t NextPinned(const std::shared_ptr<LogReader> &reader);
+    void Pin(std::list<HilogData>::iterator it, const std::vector<std::shared_ptr<LogReader>> &readers,
+        const std::vector<std::shared_ptr<LogReader>> &pinners);
+    std::list<HilogData>::iterator ErasePinned(std::list<HilogData>::iterator it,
+        const std::vector<std::shared_ptr<LogReader>> &readers);
+    void Detach(std::list<HilogData>::iterator it, const std::vector<std::shared_ptr<LogReader>> &readers);
+    void Evict(uint16_t logType, size_t limit);
+    std::vector<std::shared_ptr<LogReader>> GetReaders();
+    std::list<HilogData>::iterator Erase(std::list<HilogData>::iterator it,
+        const std::vector<std::shared_ptr<LogReader>> &readers);
+    void ReportLoss(std::shared_ptr<LogReader> reader);
+    void UnindexRecord(std::list<HilogData>::iterator it);
+    std::list<HilogData>::iterator SeekTime(uint32_t tv_sec);
+    std::list<HilogData>::iterator SeekTail(std::shared_ptr<LogReader> reader, std::list<HilogData>::iterator from);
 };
 } // namespace HiviewDFX
 } // namespace OHOS
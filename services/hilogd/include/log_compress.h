@@ -31,37 +31,56 @@ typedef struct {
     char content[MAX_PERSISTER_BUFFER_SIZE];
 } LogPersisterBuffer;
 
-const uint16_t CHUNK = 16384;
+/* room for compressing a full LogPersisterBuffer in one call: the worst case growth of deflate
+ * (deflateBound) and zstd (ZSTD_COMPRESSBOUND) plus the stream header, trailer and flush marker
+ */
+const uint32_t MAX_COMPRESS_BUFFER_SIZE = MAX_PERSISTER_BUFFER_SIZE + (MAX_PERSISTER_BUFFER_SIZE >> 8) + 512;
+typedef struct {
+    uint32_t offset;
+    char content[MAX_COMPRESS_BUFFER_SIZE];
+} LogCompressBuffer;
 
 class LogCompress {
 public:
     LogCompress();
     virtual ~LogCompress() = default;
-    virtual int Compress(LogPersisterBuffer* &buffer, LogPersisterBuffer* &compressBuffer) = 0;
-    void DeleteZData();
-    unsigned char *zdata = nullptr;
-    char buffIn[CHUNK] = {0};
-    char buffOut[CHUNK] = {0};
+    /* compress src[0, srcLen) straight into compressBuffer, ending at a flush point of the current stream.
+     * On failure nothing is added to compressBuffer and the stream is reset, the next Compress starts a new one.
+     */
+    virtual int Compress(const char *src, uint32_t srcLen, LogCompressBuffer* &compressBuffer) = 0;
+    /* end the current stream (gzip member / zstd frame), the next Compress starts a new one */
+    virtual int Finish(LogCompressBuffer* &compressBuffer);
 };
 
 class NoneCompress : public LogCompress {
 public:
-    int Compress(LogPersisterBuffer* &buffer, LogPersisterBuffer* &compressBuffer);
+    int Compress(const char *src, uint32_t srcLen, LogCompressBuffer* &compressBuffer);
 };
 
 class ZlibCompress : public LogCompress {
 public:
-    int Compress(LogPersisterBuffer* &buffer, LogPersisterBuffer* &compressBuffer);
+    ~ZlibCompress();
+    int Compress(const char *src, uint32_t srcLen, LogCompressBuffer* &compressBuffer);
+    int Finish(LogCompressBuffer* &compressBuffer);
 private:
+    int InitStream();
+    int Deflate(const char *src, uint32_t srcLen, int flush, LogCompressBuffer* &compressBuffer);
+    void ResetStream();
     z_stream cStream;
+    bool isStreamInit = false;
 };
 
 class ZstdCompress : public LogCompress {
 public:
-    int Compress(LogPersisterBuffer* &buffer, LogPersisterBuffer* &compressBuffer);
+    ~ZstdCompress();
+    int Compress(const char *src, uint32_t srcLen, LogCompressBuffer* &compressBuffer);
+    int Finish(LogCompressBuffer* &compressBuffer);
 private:
 #ifdef USING_ZSTD_COMPRESS
-    ZSTD_CCtx* cctx;
+    int InitStream();
+    int Stream(const char *src, uint32_t srcLen, ZSTD_EndDirective mode, LogCompressBuffer* &compressBuffer);
+    void ResetStream();
+    ZSTD_CCtx* cctx = nullptr;
 #endif
 };
 }
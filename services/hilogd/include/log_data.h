@@ -36,6 +36,10 @@ struct HilogData {
     uint32_t pid;
     uint32_t tid;
     uint32_t domain;
+    uint64_t seq; /* numbers the records in the order the buffer took them */
+    uint32_t evictEpoch; /* when the buffer let it go, 0 while it is counted in the buffer */
+    uint16_t pins; /* snapshot queries that still have to read it once evicted, they take it off atomically */
+    uint16_t wanted; /* bounded queries that take it, a bit each, set from where the query starts reading */
     char* tag;
     char* content;
     void init(const char *mtag, uint16_t mtagLen, const char *mfmt, size_t mfmtLen)
@@ -64,11 +68,11 @@ struct HilogData {
         tag = nullptr;
         content = nullptr;
     }
-    HilogData() : len(0), tag(nullptr), content(nullptr) {};
+    HilogData() : len(0), seq(0), evictEpoch(0), pins(0), wanted(0), tag(nullptr), content(nullptr) {};
     HilogData(const HilogMsg& msg)
         : len(0), version(msg.version), type(msg.type), level(msg.level), tag_len(msg.tag_len),
-        tv_sec(msg.tv_sec), tv_nsec(msg.tv_nsec), pid(msg.pid), tid(msg.tid), domain(msg.domain),
-        tag(nullptr), content(nullptr)
+        tv_sec(msg.tv_sec), tv_nsec(msg.tv_nsec), pid(msg.pid), tid(msg.tid), domain(msg.domain), seq(0),
+        evictEpoch(0), pins(0), wanted(0), tag(nullptr), content(nullptr)
     {
         init(msg.tag, msg.tag_len, CONTENT_PTR((&msg)), CONTENT_LEN((&msg)));
     };
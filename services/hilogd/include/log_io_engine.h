@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HILOG_IO_ENGINE_H
+#define HILOG_IO_ENGINE_H
+
+#include <atomic>
+#include <mutex>
+#include "hilog_common.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+const uint32_t LOG_IO_RING_ENTRIES = 64;
+
+/* requests of one file, the owner waits on it through LogIoEngine::Wait before it reuses or closes the file */
+class LogIoTracker {
+public:
+    void Add();
+    void Done(int error, uint64_t syncedOffset);
+    bool Busy();
+    /* the first error since the last call */
+    int TakeError();
+    /* give up on what is in flight, with error */
+    void Abandon(int error);
+    /* offset of the file up to which a completed sync made it durable */
+    uint64_t Synced();
+    void Reset();
+private:
+    std::mutex lock;
+    uint32_t inflight = 0;
+    int error = 0;
+    uint64_t syncedOffset = 0;
+};
+
+typedef struct LogIoRequest LogIoRequest;
+
+/*
+ * Fsync batching: one io_uring shared by all persist jobs that carries nothing but their
+ * IORING_OP_FSYNC requests, so a job goes on with the next block while storage catches up and
+ * the syncs of several files go to the kernel in one call. It does no writes: into the page cache
+ * they cost less than handing them over, and the jobs make them themselves. Jobs in
+ * PERSIST_SYNC_NONE never use it, they only start the writeback with sync_file_range.
+ * There is no thread of its own: Submit completes whatever the kernel is done with, and Wait
+ * blocks in the ring until the syncs of one tracker are done, completing those of other jobs on
+ * the way. Built without HILOG_PERSIST_IO_URING, on a kernel without io_uring, or once the ring
+ * failed, Available() is false and jobs call fdatasync on their own.
+ */
+class LogIoEngine {
+public:
+    static LogIoEngine& GetInstance();
+    bool Available() const;
+    /* queue an fdatasync of fd, it reports offset as synced, which the writes up to must have reached */
+    int Sync(int fd, uint64_t offset, LogIoTracker &tracker);
+    /* hand the queued requests to the kernel and complete those it is done with */
+    void Submit();
+    /* complete requests until none of tracker is in flight, returns its first error since the last Wait */
+    int Wait(LogIoTracker &tracker);
+private:
+    LogIoEngine();
+    ~LogIoEngine() = default;
+    LogIoEngine(const LogIoEngine&) = delete;
+    LogIoEngine& operator=(const LogIoEngine&) = delete;
+    int Setup();
+    int Queue(LogIoRequest *request);
+    int Enter(uint32_t toSubmit, uint32_t minComplete);
+    uint32_t SubmitQueued();
+    uint32_t Reap();
+    void Progress();
+    void Fail(int err);
+    void Complete(LogIoRequest *request, int res);
+    int ringFd = -1;
+    std::atomic<bool> broken {false};
+    std::mutex lock;     /* the submission ring and inflight */
+    std::mutex reapLock; /* the completion ring, held by whoever completes requests */
+    uint32_t inflight = 0;
+    uint32_t entries = 0;
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    void *sqes = nullptr;
+    void *cqes = nullptr;
+};
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif /* HILOG_IO_ENGINE_H */
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HILOG_MATCHER_H
+#define HILOG_MATCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace OHOS {
+namespace HiviewDFX {
+const uint32_t MAX_MATCHER_DFA_STATES = 1024;
+
+/*
+ * The -e pattern of a query, compiled once and run on the content of every record the query reads,
+ * with the result std::regex_search (ECMAScript) would give. A pattern without meta characters is
+ * searched for as it is, anything else is turned into a DFA. Patterns this can not take the same
+ * way (back references, assertions inside the pattern, counted repeats, ...) are left to hilogtool.
+ */
+class LogMatcher {
+public:
+    /* nullptr when the pattern is beyond what the matcher takes */
+    static std::unique_ptr<LogMatcher> Create(const std::string &pattern);
+    bool Match(const char *text, size_t len) const;
+private:
+    LogMatcher() = default;
+    bool FindLiteral(const char *text, size_t len) const;
+    bool RunDfa(const char *text, size_t len) const;
+    bool isLiteral = false;
+    std::string literal;
+    bool anchorStart = false;
+    bool anchorEnd = false;
+    uint8_t classOf[256] = {0};
+    uint32_t classes = 0;
+    std::vector<uint16_t> next; /* next[state * classes + class] */
+    std::vector<bool> accepting;
+    int32_t deadState = -1; /* the state nothing gets out of, if there is one */
+};
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif /* HILOG_MATCHER_H */
@@ -22,24 +22,60 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <thread>
 
 #include "log_persister_rotator.h"
 #include "log_reader.h"
 #include "log_compress.h"
+#include "persist_format.h"
 
 namespace OHOS {
 namespace HiviewDFX {
 using namespace std;
 
+const uint32_t PERSISTER_BUFFER_SLOTS = 3;
+/* room a formatted line needs on top of its text: time, pid, tid, level, domain, tag and separators */
+const uint32_t MAX_PERSIST_HEADER_LEN = MAX_TAG_LEN + 96;
+
+/* stage->layout of a stage whose slots hold framed records, older files have 0 and raw content */
+const uint32_t PERSISTER_STAGE_FRAMED = 0x46474C48;
+
+/*
+ * Every record goes into a slot as a frame: this header, then length bytes of the text lines or binary
+ * record. The slot offset only moves past a frame once it is complete, and after a crash only frames
+ * whose checksum still matches are written out, so neither a torn copy nor a page the kernel had not
+ * written back gets into the file.
+ */
+typedef struct {
+    uint32_t length;
+    uint32_t crc; /* PersistCrc32c of length and the payload, continuing from the generation of the slot */
+} LogPersisterFrame;
+
+/* mmap'ed staging area, slots[0] keeps the layout of the former single buffer so old files still restore */
+typedef struct {
+    LogPersisterBuffer slots[PERSISTER_BUFFER_SLOTS];
+    uint32_t head; /* oldest slot not written out yet */
+    uint32_t lineOffset; /* content offset of the next line of a record split over two slots, 0 if none */
+    PersistIndexEntry summaries[PERSISTER_BUFFER_SLOTS]; /* index entry of each slot, filled as records go in */
+    uint32_t layout;
+    /* bumped whenever a slot starts filling again, so frames left from its previous round never match */
+    uint32_t generations[PERSISTER_BUFFER_SLOTS];
+} LogPersisterStage;
+
 class LogPersister : public LogReader {
 public:
-    LogPersister(uint32_t id, std::string path,  uint32_t fileSize, uint16_t compressAlg, int sleepTime,
-                 LogPersisterRotator& rotator, HilogBuffer &buffer);
+    LogPersister(uint32_t id, std::string path,  uint32_t fileSize, uint16_t compressAlg, uint16_t fileFormat,
+                 int sleepTime, LogPersisterRotator& rotator, HilogBuffer &buffer);
     ~LogPersister();
     void SetBufferOffset(int off);
     void NotifyForNewData();
     int WriteData(HilogData *data);
-    int ThreadFunc();
+    /* WriteData with the text header already formatted by FormatHeader, ignored for binary files */
+    int WriteRecord(HilogData *data, const char *header, int headerLen);
+    bool TryWriteRecord(HilogData *data, const char *header, int headerLen);
+    static int FormatHeader(const HilogData *data, char *header, int headerLen);
+    void Flush();
+    void WriterThreadFunc();
     static int Kill(uint32_t id);
     void Exit();
     static int Query(uint16_t logType, std::list<LogPersistQueryResult> &results);
@@ -49,34 +85,54 @@ public:
     bool Identify(uint32_t id);
     void FillInfo(LogPersistQueryResult *response);
     int MkDirPath(const char *p_cMkdir);
-    bool writeUnCompressedBuffer(HilogData *data);
+    bool writeUnCompressedBuffer(HilogData *data, const char *header, int headerLen);
+    bool writeBinaryRecord(HilogData *data);
+    void CommitFrame(uint32_t length);
+    void AddToIndex(const HilogData *data);
     uint8_t GetType() const;
+    uint16_t GetFileFormat() const;
+    int GetSleepTime() const;
     std::string getPath();
     LogPersisterBuffer *buffer;
-    LogPersisterBuffer *compressBuffer;
+    LogCompressBuffer *compressBuffer;
 private:
     uint32_t id;
     std::string path;
     uint32_t fileSize;
     std::string mmapPath;
     uint16_t compressAlg;
+    uint16_t fileFormat;
     int sleepTime;
-    std::mutex cvMutex;
-    std::condition_variable condVariable;
-    std::mutex mutexForhasExited;
-    std::condition_variable cvhasExited;
     LogPersisterRotator *rotator;
-    bool toExit;
-    bool hasExited;
-    inline void WriteFile();
-    bool isExited();
+    bool SubmitBuffer(bool block);
+    void WriteFile(LogPersisterBuffer *pending, bool verify);
+    uint32_t Unframe(LogPersisterBuffer *pending, bool verify);
+    void WriteFileHeader();
+    void FinishFile(bool endStream);
+    uint32_t InternTag(const char *tag, uint32_t tagLen);
     FILE* fd = nullptr;
     LogCompress *compressor;
-    list<string> persistList;
     uint32_t plainLogSize;
+    LogPersisterStage *stage;
+    LogPersisterBuffer *plainBuffer; /* payloads of a slot with the frame headers taken out */
+    std::thread writer;
+    std::mutex stageMutex;
+    std::condition_variable stageQueued;
+    std::condition_variable stageFreed;
+    uint32_t queued;
+    bool refused; /* a submit found no free slot, the writer wakes the fanout when it frees one */
+    uint64_t partSeq; /* seq of the record stage->lineOffset belongs to after TryWriteRecord refused it */
+    bool writerExit;
+    uint64_t stallCount; /* counted only, reported once at Exit */
+    uint64_t stallUs;
+    bool fileStarted;
+    /* binary format state of the block in the current slot, reset whenever a slot starts */
+    uint64_t lastTime;
+    uint32_t tagCount;
+    uint16_t tagSlots[PERSIST_MAX_TAGS * 2]; /* open addressing over tagNames, index + 1, 0 if free */
+    char tagNames[PERSIST_MAX_TAGS][MAX_TAG_LEN];
 };
 
-int GenPersistLogHeader(HilogData *data, list<string>& persistList);
 } // namespace HiviewDFX
 } // namespace OHOS
 #endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _HILOG_PERSISTER_FANOUT_H
+#define _HILOG_PERSISTER_FANOUT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include "log_buffer.h"
+#include "log_persister.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+/* records a job behind the fanout gets from its cursor per round, before the fanout reads on */
+const uint32_t PERSIST_CATCHUP_BATCH = 64;
+
+class LogPersisterCursor;
+
+/*
+ * The one reader of the buffer for all persist jobs. Every record is read and matched once against
+ * the union of the job filters, its text header is formatted once, and it is handed to each job
+ * whose types and levels take it. A job that joins while others run first gets the records the
+ * fanout has already passed, from a cursor of its own, so it still starts at the oldest record.
+ * Records are handed over without waiting: a job whose writer is behind goes on from a cursor of
+ * its own as well, and both kinds come back to the fanout once their cursor stands where it does.
+ */
+class LogPersisterFanout : public LogReader {
+public:
+    static LogPersisterFanout& GetInstance(HilogBuffer &buffer);
+    void Add(std::shared_ptr<LogPersister> job);
+    /* after it returns the job gets no more records */
+    void Remove(std::shared_ptr<LogPersister> job);
+    void NotifyForNewData();
+    int WriteData(HilogData *data);
+    uint8_t GetType() const;
+private:
+    explicit LogPersisterFanout(HilogBuffer &buffer);
+    void ThreadFunc();
+    void UpdateJobs();
+    void Park(std::shared_ptr<LogPersister> job);
+    bool CatchUp(std::shared_ptr<LogPersisterCursor> cursor);
+    void Rejoin(std::shared_ptr<LogPersisterCursor> cursor);
+    void Dispatch(HilogData *data);
+    bool started = false;
+    std::atomic<bool> jobsChanged {false};
+    int sleepTime = 0;
+    std::mutex jobMutex;  /* jobs, joining and catching, never held while records are handed over */
+    std::mutex passMutex; /* held by the fanout thread while it hands records over, which does not wait */
+    std::mutex cvMutex;
+    std::condition_variable condVariable;
+    std::list<std::shared_ptr<LogPersister>> jobs;
+    std::list<std::shared_ptr<LogPersister>> joining;
+    std::list<std::shared_ptr<LogPersisterCursor>> catching;
+    /* the fanout thread only */
+    std::list<std::shared_ptr<LogPersister>> active;
+    std::list<std::shared_ptr<LogPersister>> stalled;
+};
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif
@@ -14,50 +14,80 @@
  */
 #ifndef _HILOG_PERSISTER_ROTATOR_H
 #define _HILOG_PERSISTER_ROTATOR_H
-#include <fstream>
+#include <chrono>
+#include <cstdio>
 #include <string>
 #include <zlib.h>
 #include "hilog_common.h"
 #include "hilogtool_msg.h"
 #include "log_buffer.h"
+#include "log_io_engine.h"
+#include "persist_format.h"
 namespace OHOS {
 namespace HiviewDFX {
 typedef struct {
-    uint8_t index;
+    uint8_t index; /* unused, the manifest keeps the file sequence */
     uint16_t types;
     uint8_t levels;
     LogPersistStartMsg msg;
 } PersistRecoveryInfo;
+/* what a hilogd from before fileFormat and syncMode saved, the new fields take their defaults */
+const size_t PERSIST_INFO_V1_LEN = offsetof(PersistRecoveryInfo, msg) + PERSIST_START_MSG_V1_LEN;
 
 const std::string ANXILLARY_FILE_NAME = "persisterInfo_";
-uint64_t GetInfoHash(const PersistRecoveryInfo &info);
+const uint32_t PERSIST_IO_ALIGN = 4096;
+/* writes from this length on bypass the page cache when built with HILOG_PERSIST_DIRECT_IO */
+const uint32_t PERSIST_DIRECT_MIN_LEN = 32 * 1024;
+uint64_t GetInfoHash(const PersistRecoveryInfo &info, size_t len);
 class LogPersisterRotator {
 public:
-    LogPersisterRotator(std::string path, uint32_t fileSize, uint32_t fileNum, std::string suffix = "");
+    LogPersisterRotator(std::string path, uint32_t fileSize, uint32_t fileNum, std::string suffix = "",
+        uint16_t syncMode = PERSIST_SYNC_NONE);
     ~LogPersisterRotator();
     int Init();
     int Input(const char *buf, uint32_t length);
-    void FillInfo(uint32_t *size, uint32_t *num);
+    /* input one self-contained compressed block and list it in the index of the current file */
+    int InputBlock(const char *buf, uint32_t length, PersistIndexEntry &entry);
+    void FillInfo(uint32_t *size, uint32_t *num, uint16_t *sync);
     void FinishInput();
-    void SetIndex(int pIndex);
     void SetId(uint32_t pId);
     void OpenInfoFile();
-    void UpdateRotateNumber();
     int SaveInfo(const LogPersistStartMsg& pMsg, const QueryCondition queryCondition);
     void WriteRecoveryInfo();
     void SetRestore(bool flag);
     bool GetRestore();
 protected:
-    void InternalRotate();
     uint32_t fileNum;
     uint32_t fileSize;
     std::string fileName;
     std::string fileSuffix;
-    int index;
-    std::fstream output;
+    int index; /* sequence number of the current file, it goes to slot index % fileNum */
+    uint16_t syncMode;
+    int output = -1;
+    int indexOutput = -1;
+    int directOutput = -1; /* O_DIRECT fd of the same file, -1 when direct I/O is off or unsupported */
+    uint64_t fileOffset = 0;
+    uint32_t indexEntries = 0;
+    void OpenOutput(const std::string &name);
+    void CloseOutput();
+    void SyncOutput(bool force);
+    int WriteOutput(const char *buf, uint32_t length);
+    int WriteDirect(const char *buf, uint32_t length);
+    bool SyncAsync(int fd, bool force);
 private:
+    void PrepareOutput();
     void Rotate();
+    std::string SlotName(uint32_t seq);
+    void WriteManifest();
+    void AdoptUnlistedFiles();
     bool needRotate = false;
+    uint64_t syncedOffset = 0;    /* below it the file is on storage, or on its way in PERSIST_SYNC_NONE */
+    uint64_t cachedOffset = 0;    /* below it the page cache of the file was dropped */
+    std::chrono::steady_clock::time_point lastSync;
+    LogIoEngine &ioEngine;
+    LogIoTracker ioTracker;
+    char *directBuf = nullptr; /* aligned, starts with the partial last page of the file */
+    uint32_t directBufLen = 0;
     FILE* fdinfo = nullptr;
     uint32_t id = 0;
     std::string infoPath;
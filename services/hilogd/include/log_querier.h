@@ -15,6 +15,11 @@
 #ifndef LOG_QUERIER_H
 #define LOG_QUERIER_H
 #include <sys/socket.h>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
 #include "log_buffer.h"
 #include "log_reader.h"
 
@@ -23,13 +28,50 @@ namespace HiviewDFX {
 class LogQuerier : public LogReader {
 public:
     LogQuerier(std::unique_ptr<Socket> handler, HilogBuffer* buffer);
-    static void LogQuerierThreadFunc(std::shared_ptr<LogReader> logReader);
+    /* called by LogQuerierReactor on its thread, false ends the connection */
+    bool OnReadable();
+    bool OnWritable();
+    void OnWakeup();
+    bool WantRead() const;
+    bool WantWrite() const;
+    int GetWakeFd() const;
+    void Close();
     int WriteData(LogQueryResponse& rsp, HilogData* data);
     int WriteData(HilogData* data);
     void NotifyForNewData();
+    void Reply(const char* msg, size_t len);
+    void WriteLoss(uint32_t lines, bool closing);
     uint8_t GetType() const;
     int RestorePersistJobs(HilogBuffer& _buffer);
-    ~LogQuerier() = default;
+    ~LogQuerier();
+private:
+    void StartStream(uint8_t version, uint32_t grant);
+    void GrantCredit(uint32_t grant);
+    void Pump();
+    int AppendFrame(HilogData* data);
+    int FlushFrame();
+    int Send(iovec* vec, unsigned int count);
+    bool OpenWakeFd();
+    void Offload(std::function<void()> handle);
+    void SendReplies();
+    bool streaming = false;
+    uint8_t version = 0; /* of the responses, as far as both ends speak it */
+    std::unique_ptr<char[]> request; /* every message from the client is read into this */
+    std::unique_ptr<char[]> frame; /* a LogQueryFrame being filled, only with LOG_QUERY_VERSION_BATCH */
+    uint16_t frameLen = 0;
+    int64_t credit = 0; /* bytes the client still takes, it may go below 0 by the last record sent */
+    uint32_t sent = 0; /* records, against the head count of the query */
+    bool headEnded = false; /* SENDIDN went out after the head count */
+    int wakeFd = -1; /* eventfd the collector and the worker wake the connection with */
+    std::atomic<bool> newData {false}; /* a query that does not stream is to be told of new records */
+    std::list<std::string> pendingOut; /* messages the socket did not take yet, a few at most */
+    bool busy = false; /* a control command runs on the worker, request stays as it is until it is done */
+    std::mutex replyLock; /* the worker hands over replies and jobDone with it */
+    std::list<std::string> replies; /* to control commands, not sent yet */
+    bool jobDone = false;
+    bool takesLoss = false; /* the client speaks LOG_QUERY_VERSION_LOSS */
+    bool disconnecting = false; /* its queue ran over, the client is let go once pendingOut is sent */
+    uint64_t lostTotal = 0;
 };
 } // namespace HiviewDFX
 } // namespace OHOS
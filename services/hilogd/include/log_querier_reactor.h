@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef LOG_QUERIER_REACTOR_H
+#define LOG_QUERIER_REACTOR_H
+
+#include <sys/epoll.h>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "log_buffer.h"
+#include "log_querier.h"
+#include "socket.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+const int MAX_REACTOR_EVENTS = 64;
+
+/*
+ * Runs every control and query connection on one thread with epoll, however many clients there are.
+ * Sockets do not block, each LogQuerier keeps the state of its connection between events and a
+ * client that fills its socket waits for EPOLLOUT instead of blocking the others. Control commands
+ * that start or stop persist jobs or walk the whole buffer run on one worker thread, one at a time.
+ */
+class LogQuerierReactor {
+public:
+    static LogQuerierReactor& GetInstance();
+    int Add(std::unique_ptr<Socket> handler, HilogBuffer* buffer);
+    void Post(std::function<void()> job);
+private:
+    struct Connection {
+        std::shared_ptr<LogQuerier> querier;
+        int sockFd = -1;
+        int wakeFd = -1; /* as registered, the querier opens one to be woken */
+        uint32_t events = EPOLLIN; /* registered for sockFd */
+    };
+    LogQuerierReactor();
+    void ThreadFunc();
+    void WorkerFunc();
+    void Dispatch(int fd, uint32_t events);
+    void Update(std::shared_ptr<Connection> conn);
+    void Remove(std::shared_ptr<Connection> conn);
+    int epollFd = -1;
+    std::mutex lock; /* connections gets added to by the accepting thread */
+    std::unordered_map<int, std::shared_ptr<Connection>> connections; /* by socket and by eventfd */
+    std::mutex jobLock;
+    std::condition_variable jobCv;
+    std::list<std::function<void()>> jobs; /* one per connection at most, it reads no requests meanwhile */
+};
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif
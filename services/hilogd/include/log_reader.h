@@ -16,12 +16,14 @@
 #ifndef LOG_READER_H
 #define LOG_READER_H
 
+#include <atomic>
 #include <cstddef>
 #include <iterator>
 #include <list>
 #include <memory>
 #include <typeindex>
 #include "log_data.h"
+#include "log_matcher.h"
 #include "hilogtool_msg.h"
 #include "socket.h"
 
@@ -50,6 +52,14 @@ using QueryCondition = struct QueryCondition {
     uint32_t noPids[MAX_PIDS];
     uint32_t noDomains[MAX_DOMAINS];
     std::string noTags[MAX_TAGS];
+    std::shared_ptr<LogMatcher> matcher; /* on the content, none when nullptr */
+    uint64_t beginTime = 0; /* nanoseconds since the epoch */
+    uint64_t endTime = UINT64_MAX;
+    uint16_t headCount = 0; /* the first or the last records that match only, 0 for no limit */
+    uint16_t tailCount = 0;
+    uint32_t queueLines = 0; /* records that came in after the query started and wait for it, 0 for no limit */
+    uint8_t dropPolicy = QUEUE_DROP_OLDEST;
+    bool snapshot = false;
 };
 
 class LogReader : public std::enable_shared_from_this<LogReader> {
@@ -59,7 +69,19 @@ public:
     std::list<HilogData> oldData;
     QueryCondition queryCondition;
     std::unique_ptr<Socket> hilogtoolConnectSocket;
-    bool isNotified;
+    std::atomic<bool> isNotified; /* set by the collector, cleared by the reader */
+    /* these are kept by HilogBuffer under its lock */
+    uint64_t startSeq = 0; /* seq of the first record that came in after the query started */
+    uint64_t dropBegin = 0; /* records with seq in [dropBegin, dropEnd) are skipped, for QUEUE_DROP_NEWEST */
+    uint64_t dropEnd = 0;
+    uint32_t lostLines = 0; /* dropped since the reader was last told */
+    uint64_t snapshotEnd = 0; /* a snapshot query reads the records with seq below it only, 0 for none */
+    uint32_t pinEpoch = 0; /* records evicted later than this the snapshot keeps pinned */
+    std::list<HilogData>::iterator pinPos[LOG_TYPE_MAX]; /* the next of HilogBuffer::pinnedList it looks at */
+    size_t pinnedBytes = 0; /* of the records the snapshot keeps pinned */
+    bool pinCut = false; /* the snapshot kept MAX_PINNED_BYTES, it pins no more and loses what goes ahead of it */
+    uint32_t pending = 0; /* records in its queue it takes, counted as they come in, with queueLines only */
+    uint16_t queueMask = 0; /* its bit in HilogData::wanted, 0 when all of them are in use and it matches instead */
 
     LogReader();
     virtual ~LogReader();
@@ -69,6 +91,8 @@ public:
     void NotifyReload();
 
     virtual int WriteData(HilogData* data) =0;
+    /* lines lost before the next record, with closing set the reader gets no more */
+    virtual void WriteLoss(uint32_t, bool) {}
     void SetSendId(unsigned int value);
     void SetCmd(uint8_t value);
     virtual uint8_t GetType() const = 0;
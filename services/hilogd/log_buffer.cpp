@@ -37,6 +37,19 @@ static int g_maxBufferSizeByType[LOG_TYPE_MAX] = {1048576, 1048576, 1048576, 104
 const int DOMAIN_STRICT_MASK = 0xd000000;
 const int DOMAIN_FUZZY_MASK = 0xdffff;
 const int DOMAIN_MODULE_BITS = 8;
+const uint64_t NS_PER_SEC = 1000000000ULL;
+
+/* a query with queueLines, Insert counts the records it takes */
+static bool Bounded(const std::shared_ptr<LogReader> &reader)
+{
+    return reader->queryCondition.queueLines > 0 && !reader->queryCondition.snapshot;
+}
+
+/* the order of hilogDataList: by second, and within one in the order the records came in */
+static bool Before(const HilogData &a, const HilogData &b)
+{
+    return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.seq < b.seq);
+}
 
 HilogBuffer::HilogBuffer()
 {
@@ -60,57 +73,47 @@ size_t HilogBuffer::Insert(const HilogMsg& msg)
         return 0;
     }
 
+    /* the record is copied before the lock is taken, under it the node is only linked in */
+    std::list<HilogData> node;
+    node.emplace_back(msg);
+    hilogBufferMutex.lock();
     // Delete old entries when full
     if (eleSize + sizeByType[msg.type] >= (size_t)g_maxBufferSizeByType[msg.type]) {
-        hilogBufferMutex.lock();
         // Drop 5% of maximum log when full
-        std::list<HilogData>::iterator it = hilogDataList.begin();
-        while (sizeByType[msg.type] > g_maxBufferSizeByType[msg.type] * (1 - DROP_RATIO) &&
-            it != hilogDataList.end()) {
-            if ((*it).type != msg.type) {    // Only remove old logs of the same type
-                ++it;
-                continue;
-            }
-            logReaderListMutex.lock_shared();
-            for (auto &itr :logReaderList) {
-                if (itr.lock()->readPos == it) {
-                    itr.lock()->readPos = std::next(it);
-                }
-                if (itr.lock()->lastPos == it) {
-                    itr.lock()->lastPos = std::next(it);
-                }
-            }
-            logReaderListMutex.unlock_shared();
-            size_t cLen = it->len - it->tag_len;
-            size -= cLen;
-            sizeByType[(*it).type] -= cLen;
-            it = hilogDataList.erase(it);
-        }
+        Evict(msg.type, static_cast<size_t>(g_maxBufferSizeByType[msg.type] * (1 - DROP_RATIO)));
 
         // Re-confirm if enough elements has been removed
         if (sizeByType[msg.type] >= (size_t)g_maxBufferSizeByType[msg.type]) {
             std::cout << "Failed to clean old logs." << std::endl;
         }
-        hilogBufferMutex.unlock();
     }
 
     // Insert new log into HilogBuffer
-    std::list<HilogData>::reverse_iterator rit = hilogDataList.rbegin();
-    if (msg.tv_sec >= (rit->tv_sec)) {
-        hilogDataList.emplace_back(msg);
+    node.front().seq = nextSeq++;
+    std::list<HilogData>::iterator pos = node.begin();
+    if (hilogDataList.empty() || msg.tv_sec >= hilogDataList.back().tv_sec) {
+        hilogDataList.splice(hilogDataList.end(), node);
+        if (++sinceIndexed >= TIME_INDEX_STRIDE) {
+            timeIndex.push_back({msg.tv_sec, std::prev(hilogDataList.end())});
+            sinceIndexed = 0;
+        }
     } else {
         // Find the place with right timestamp
+        std::vector<std::shared_ptr<LogReader>> readers = GetReaders();
+        std::list<HilogData>::reverse_iterator rit = hilogDataList.rbegin();
         ++rit;
         for (; rit != hilogDataList.rend() && msg.tv_sec < rit->tv_sec; ++rit) {
-            logReaderListMutex.lock_shared();
-            for (auto &itr :logReaderList) {
-                if (itr.lock()->readPos == std::prev(rit.base())) {
-                    itr.lock()->oldData.emplace_front(msg);
+            for (auto &reader : readers) {
+                /* a snapshot query does not take records that came in after it started */
+                if (reader->snapshotEnd == 0 && reader->readPos == std::prev(rit.base())) {
+                    reader->oldData.emplace_front(msg);
                 }
             }
-            logReaderListMutex.unlock_shared();
         }
-        hilogDataList.emplace(rit.base(), msg);
+        hilogDataList.splice(rit.base(), node);
+    }
+    if (!queueReaders.empty()) {
+        CountQueued(pos);
     }
     // Update current size of HilogBuffer
     size += eleSize;
@@ -121,6 +124,7 @@ size_t HilogBuffer::Insert(const HilogMsg& msg)
     } else {
         cacheLenByDomain[msg.domain] += eleSize;
     }
+    hilogBufferMutex.unlock();
     return eleSize;
 }
 
@@ -131,48 +135,121 @@ bool HilogBuffer::Query(std::shared_ptr<LogReader> reader)
     if (reader->GetReload()) {
         reader->readPos = hilogDataList.begin();
         reader->lastPos = hilogDataList.begin();
+        if (reader->queryCondition.beginTime > 0) {
+            reader->readPos = SeekTime(reader->queryCondition.beginTime / NS_PER_SEC);
+        }
+        if (reader->queryCondition.tailCount > 0) {
+            reader->readPos = SeekTail(reader, reader->readPos);
+        }
+        if (reader->readPos != hilogDataList.begin()) {
+            reader->lastPos = std::prev(reader->readPos);
+        }
+        reader->startSeq = nextSeq;
+        reader->dropBegin = 0;
+        reader->dropEnd = 0;
+        reader->lostLines = 0;
+        reader->snapshotEnd = reader->queryCondition.snapshot ? nextSeq.load() : 0;
+        reader->pinEpoch = evictEpoch;
+        for (uint16_t type = 0; type < LOG_TYPE_MAX; type++) {
+            reader->pinPos[type] = pinnedList[type].end();
+        }
+        reader->pinnedBytes = 0;
+        reader->pinCut = false;
+        reader->pending = 0;
+        if (reader->queueMask != 0) {
+            MarkWanted(reader);
+        }
         reader->SetReload(false);
     }
+    uint64_t endSec = reader->queryCondition.endTime / NS_PER_SEC;
 
     if (reader->isNotified) {
         if (reader->readPos == hilogDataList.end()) {
             reader->readPos = std::next(reader->lastPos);
         }
     }
+    if (reader->queryCondition.queueLines > 0 && reader->snapshotEnd == 0 && !TrimQueue(reader)) {
+        hilogBufferMutex.unlock_shared();
+        return false;
+    }
     // Look up in oldData first
     if (!reader->oldData.empty()) {
+        if (reader->pending > 0 && ConditionMatch(reader, std::prev(reader->oldData.end()))) {
+            reader->pending--;
+        }
+        ReportLoss(reader);
         reader->SetSendId(SENDIDA);
         reader->WriteData(&(reader->oldData.back()));
-        printLenByType[(reader->oldData.back()).type] += strlen(reader->oldData.back().content);
-        if (printLenByDomain.count(reader->oldData.back().domain) == 0) {
-            printLenByDomain.insert(pair<uint32_t, uint64_t>(reader->oldData.back().domain,
-                strlen(reader->oldData.back().content)));
-        } else {
-            printLenByDomain[reader->oldData.back().domain] += strlen(reader->oldData.back().content);
-        }
+        CountPrinted(reader->oldData.back());
         reader->oldData.pop_back();
         hilogBufferMutex.unlock_shared();
         return true;
     }
-    while (reader->readPos != hilogDataList.end()) {
+    while (true) {
+        uint16_t pinType = (reader->snapshotEnd > 0) ? NextPinned(reader) : LOG_TYPE_MAX;
+        if (pinType != LOG_TYPE_MAX &&
+            (reader->readPos == hilogDataList.end() || Before(*reader->pinPos[pinType], *reader->readPos))) {
+            /* let go by the buffer before the snapshot got to it, it comes first */
+            if (reader->pinPos[pinType]->tv_sec > endSec) {
+                break;
+            }
+            std::list<HilogData>::iterator pos = reader->pinPos[pinType]++;
+            if (!Pinned(reader, pos)) {
+                continue;
+            }
+            /* pinned whether it takes it or not, others may pass it at the same time under the shared lock */
+            (void)__atomic_sub_fetch(&pos->pins, 1, __ATOMIC_RELAXED);
+            reader->pinnedBytes -= pos->len - pos->tag_len;
+            if (ConditionMatch(reader, pos)) {
+                ReportLoss(reader);
+                reader->SetSendId(SENDIDA);
+                reader->WriteData(&*pos);
+                CountPrinted(*pos);
+                hilogBufferMutex.unlock_shared();
+                return true;
+            }
+            continue;
+        }
+        if (reader->readPos == hilogDataList.end() || reader->readPos->tv_sec > endSec) {
+            /* sorted by time, nothing from here on is in the range */
+            break;
+        }
         reader->lastPos = reader->readPos;
-        if (ConditionMatch(reader)) {
+        std::list<HilogData>::iterator pos = reader->readPos;
+        bool take = ConditionMatch(reader, pos);
+        if (take && reader->pending > 0 && pos->seq >= reader->startSeq) {
+            /* leaves its queue, sent or lost */
+            reader->pending--;
+        }
+        if (reader->snapshotEnd > 0 && pos->seq >= reader->snapshotEnd) {
+            /* came in after the snapshot was taken */
+            take = false;
+        } else if (pos->seq >= reader->dropBegin && pos->seq < reader->dropEnd) {
+            /* came in while the queue of the reader was full */
+            if (take) {
+                reader->lostLines++;
+            }
+            take = false;
+        }
+        if (take) {
+            ReportLoss(reader);
             reader->SetSendId(SENDIDA);
             reader->WriteData(&*(reader->readPos));
-            printLenByType[reader->readPos->type] += strlen(reader->readPos->content);
-            if (printLenByDomain.count(reader->readPos->domain) == 0) {
-                printLenByDomain.insert(pair<uint32_t, uint64_t>(reader->readPos->domain,
-                    strlen(reader->readPos->content)));
-            } else {
-                printLenByDomain[reader->readPos->domain] += strlen(reader->readPos->content);
-            }
+            CountPrinted(*(reader->readPos));
             reader->readPos++;
             hilogBufferMutex.unlock_shared();
             return true;
         }
         reader->readPos++;
     }
+    if (reader->pending > 0 && reader->readPos == hilogDataList.end() &&
+        std::next(reader->lastPos) == hilogDataList.end()) {
+        /* counted but never got to, it came in behind the reader or went with no bit to tell */
+        reader->lostLines += reader->pending;
+        reader->pending = 0;
+    }
     reader->isNotified = false;
+    ReportLoss(reader);
     ReturnNoLog(reader);
     hilogBufferMutex.unlock_shared();
     return false;
@@ -185,6 +262,7 @@ size_t HilogBuffer::Delete(uint16_t logType)
     }
     size_t sum = 0;
     hilogBufferMutex.lock();
+    std::vector<std::shared_ptr<LogReader>> readers = GetReaders();
     std::list<HilogData>::iterator it = hilogDataList.begin();
 
     // Delete logs corresponding to queryCondition
@@ -195,31 +273,68 @@ size_t HilogBuffer::Delete(uint16_t logType)
             continue;
         }
         // Delete corresponding logs
-        logReaderListMutex.lock_shared();
-        for (auto itr = logReaderList.begin(); itr != logReaderList.end();) {
-            if ((*itr).lock()->readPos == it) {
-                (*itr).lock()->readPos = std::next(it);
+        for (auto &reader : readers) {
+            if (reader->readPos == it) {
+                if (Bounded(reader) && it->seq >= reader->startSeq && reader->pending > 0 && Wanted(reader, it)) {
+                    /* cleared on purpose, not lost */
+                    reader->pending--;
                 }
-            if ((*itr).lock()->lastPos == it) {
-                (*itr).lock()->lastPos = std::next(it);
+                reader->readPos = std::next(it);
+            }
+            if (reader->lastPos == it) {
+                reader->lastPos = std::next(it);
             }
-            ++itr;
         }
-        logReaderListMutex.unlock_shared();
 
         size_t cLen = it->len - it->tag_len;
         sum += cLen;
         sizeByType[(*it).type] -= cLen;
         size -= cLen;
+        UnindexRecord(it);
         it = hilogDataList.erase(it);
     }
 
+    /* what was let go of it goes as well, the snapshots that kept it pinned no longer count it */
+    std::vector<std::shared_ptr<LogReader>> reached;
+    it = pinnedList[logType].begin();
+    while (it != pinnedList[logType].end()) {
+        for (auto &reader : readers) {
+            if (reader->snapshotEnd > 0 && reader->pinPos[logType] == it &&
+                std::find(reached.begin(), reached.end(), reader) == reached.end()) {
+                reached.push_back(reader);
+            }
+        }
+        for (auto &reader : reached) {
+            if (Pinned(reader, it)) {
+                reader->pinnedBytes -= it->len - it->tag_len;
+            }
+        }
+        sum += it->len - it->tag_len;
+        it = ErasePinned(it, readers);
+    }
+
     hilogBufferMutex.unlock();
     return sum;
 }
 
 void HilogBuffer::AddLogReader(std::weak_ptr<LogReader> reader)
 {
+    std::shared_ptr<LogReader> added = reader.lock();
+    if (added->queryCondition.queueLines > 0 && !added->queryCondition.snapshot) {
+        hilogBufferMutex.lock();
+        if (std::find(queueReaders.begin(), queueReaders.end(), added) == queueReaders.end()) {
+            added->queueMask = 0;
+            for (uint16_t bit = 1; bit != 0; bit <<= 1) {
+                if ((queueMasks & bit) == 0) {
+                    added->queueMask = bit;
+                    queueMasks |= bit;
+                    break;
+                }
+            }
+            queueReaders.push_back(added);
+        }
+        hilogBufferMutex.unlock();
+    }
     logReaderListMutex.lock();
     // If reader not in logReaderList
     logReaderList.push_back(reader);
@@ -229,6 +344,19 @@ void HilogBuffer::AddLogReader(std::weak_ptr<LogReader> reader)
 
 void HilogBuffer::RemoveLogReader(std::shared_ptr<LogReader> reader)
 {
+    if (reader->snapshotEnd > 0) {
+        Unpin(reader);
+    }
+    if (reader->queryCondition.queueLines > 0) {
+        hilogBufferMutex.lock();
+        const auto queued = std::find(queueReaders.begin(), queueReaders.end(), reader);
+        if (queued != queueReaders.end()) {
+            queueMasks &= ~reader->queueMask;
+            reader->queueMask = 0;
+            queueReaders.erase(queued);
+        }
+        hilogBufferMutex.unlock();
+    }
     logReaderListMutex.lock();
     const auto findIter = std::find_if(logReaderList.begin(), logReaderList.end(),
         [&reader](const std::weak_ptr<LogReader>& ptr0) {
@@ -250,7 +378,9 @@ size_t HilogBuffer::GetBuffLen(uint16_t logType)
     if (logType >= LOG_TYPE_MAX) {
         return ERR_LOG_TYPE_INVALID;
     }
+    hilogBufferMutex.lock_shared();
     uint64_t buffSize = g_maxBufferSizeByType[logType];
+    hilogBufferMutex.unlock_shared();
     return buffSize;
 }
 
@@ -265,29 +395,10 @@ size_t HilogBuffer::SetBuffLen(uint16_t logType, uint64_t buffSize)
     hilogBufferMutex.lock();
     if (sizeByType[logType] > buffSize) {
         // Drop old log when buffsize not enough
-        std::list<HilogData>::iterator it = hilogDataList.begin();
-        while (sizeByType[logType] > buffSize && it != hilogDataList.end()) {
-            if ((*it).type != logType) {    // Only remove old logs of the same type
-                ++it;
-                continue;
-            }
-            logReaderListMutex.lock_shared();
-            for (auto &itr :logReaderList) {
-                if (itr.lock()->readPos == it) {
-                    itr.lock()->readPos = std::next(it);
-                }
-                if (itr.lock()->lastPos == it) {
-                    itr.lock()->lastPos = std::next(it);
-                }
-            }
-            logReaderListMutex.unlock_shared();
-            size_t cLen = it->len - it->tag_len;
-            size -= cLen;
-            sizeByType[(*it).type] -= cLen;
-            it = hilogDataList.erase(it);
-        }
+        Evict(logType, buffSize);
         // Re-confirm if enough elements has been removed
         if (sizeByType[logType] > (size_t)g_maxBufferSizeByType[logType] || size > (size_t)g_maxBufferSize) {
+            hilogBufferMutex.unlock();
             return ERR_BUFF_SIZE_EXP;
         }
         g_maxBufferSizeByType[logType] = buffSize;
@@ -305,8 +416,11 @@ int32_t HilogBuffer::GetStatisticInfoByLog(uint16_t logType, uint64_t& printLen,
     if (logType >= LOG_TYPE_MAX) {
         return ERR_LOG_TYPE_INVALID;
     }
-    printLen = printLenByType[logType];
+    hilogBufferMutex.lock_shared();
     cacheLen = cacheLenByType[logType];
+    hilogBufferMutex.unlock_shared();
+    std::lock_guard<std::mutex> guard(statisticMutex);
+    printLen = printLenByType[logType];
     dropped = GetDroppedByType(logType);
     return 0;
 }
@@ -314,8 +428,14 @@ int32_t HilogBuffer::GetStatisticInfoByLog(uint16_t logType, uint64_t& printLen,
 int32_t HilogBuffer::GetStatisticInfoByDomain(uint32_t domain, uint64_t& printLen, uint64_t& cacheLen,
     int32_t& dropped)
 {
-    printLen = printLenByDomain[domain];
-    cacheLen = cacheLenByDomain[domain];
+    /* find, not [], a query for a domain that never logged must not add it to the maps */
+    hilogBufferMutex.lock_shared();
+    auto cacheIt = cacheLenByDomain.find(domain);
+    cacheLen = (cacheIt != cacheLenByDomain.end()) ? cacheIt->second : 0;
+    hilogBufferMutex.unlock_shared();
+    std::lock_guard<std::mutex> guard(statisticMutex);
+    auto printIt = printLenByDomain.find(domain);
+    printLen = (printIt != printLenByDomain.end()) ? printIt->second : 0;
     dropped = GetDroppedByDomain(domain);
     return 0;
 }
@@ -326,8 +446,11 @@ int32_t HilogBuffer::ClearStatisticInfoByLog(uint16_t logType)
         return ERR_LOG_TYPE_INVALID;
     }
     ClearDroppedByType();
-    printLenByType[logType] = 0;
+    hilogBufferMutex.lock();
     cacheLenByType[logType] = 0;
+    hilogBufferMutex.unlock();
+    std::lock_guard<std::mutex> guard(statisticMutex);
+    printLenByType[logType] = 0;
     droppedByType[logType] = 0;
     return 0;
 }
@@ -335,26 +458,38 @@ int32_t HilogBuffer::ClearStatisticInfoByLog(uint16_t logType)
 int32_t HilogBuffer::ClearStatisticInfoByDomain(uint32_t domain)
 {
     ClearDroppedByDomain();
-    printLenByDomain[domain] = 0;
-    cacheLenByDomain[domain] = 0;
-    droppedByDomain[domain] = 0;
+    hilogBufferMutex.lock();
+    auto cacheIt = cacheLenByDomain.find(domain);
+    if (cacheIt != cacheLenByDomain.end()) {
+        cacheIt->second = 0;
+    }
+    hilogBufferMutex.unlock();
+    std::lock_guard<std::mutex> guard(statisticMutex);
+    auto printIt = printLenByDomain.find(domain);
+    if (printIt != printLenByDomain.end()) {
+        printIt->second = 0;
+    }
+    auto droppedIt = droppedByDomain.find(domain);
+    if (droppedIt != droppedByDomain.end()) {
+        droppedIt->second = 0;
+    }
     return 0;
 }
 
-bool HilogBuffer::ConditionMatch(std::shared_ptr<LogReader> reader)
+bool HilogBuffer::ConditionMatch(const std::shared_ptr<LogReader> &reader, std::list<HilogData>::iterator pos)
 {
     /* domain patterns:
      * strict mode: 0xdxxxxxx   (full)
      * fuzzy mode: 0xdxxxx      (using last 2 digits of full domain as mask)
      */
-    if (((static_cast<uint8_t>((0b01 << (reader->readPos->type)) & (reader->queryCondition.types)) == 0) ||
-        (static_cast<uint8_t>((0b01 << (reader->readPos->level)) & (reader->queryCondition.levels)) == 0)))
+    if (((static_cast<uint8_t>((0b01 << (pos->type)) & (reader->queryCondition.types)) == 0) ||
+        (static_cast<uint8_t>((0b01 << (pos->level)) & (reader->queryCondition.levels)) == 0)))
         return false;
 
     int ret = 0;
     if (reader->queryCondition.nPid > 0) {
         for (int i = 0; i < reader->queryCondition.nPid; i++) {
-            if (reader->readPos->pid == reader->queryCondition.pids[i]) {
+            if (pos->pid == reader->queryCondition.pids[i]) {
                 ret = 1;
                 break;
             }
@@ -365,8 +500,8 @@ bool HilogBuffer::ConditionMatch(std::shared_ptr<LogReader> reader)
     if (reader->queryCondition.nDomain > 0) {
         for (int i = 0; i < reader->queryCondition.nDomain; i++) {
             uint32_t domains = reader->queryCondition.domains[i];
-            if (!((domains >= DOMAIN_STRICT_MASK && domains != reader->readPos->domain) ||
-                (domains <= DOMAIN_FUZZY_MASK && domains != (reader->readPos->domain >> DOMAIN_MODULE_BITS)))) {
+            if (!((domains >= DOMAIN_STRICT_MASK && domains != pos->domain) ||
+                (domains <= DOMAIN_FUZZY_MASK && domains != (pos->domain >> DOMAIN_MODULE_BITS)))) {
                 ret = 1;
                 break;
             }
@@ -376,7 +511,7 @@ bool HilogBuffer::ConditionMatch(std::shared_ptr<LogReader> reader)
     }
     if (reader->queryCondition.nTag > 0) {
         for (int i = 0; i < reader->queryCondition.nTag; i++) {
-            if (reader->readPos->tag == reader->queryCondition.tags[i]) {
+            if (pos->tag == reader->queryCondition.tags[i]) {
                 ret = 1;
                 break;
             }
@@ -388,29 +523,423 @@ bool HilogBuffer::ConditionMatch(std::shared_ptr<LogReader> reader)
     // exclusion
     if (reader->queryCondition.nNoPid > 0) {
         for (int i = 0; i < reader->queryCondition.nNoPid; i++) {
-            if (reader->readPos->pid == reader->queryCondition.noPids[i]) return false;
+            if (pos->pid == reader->queryCondition.noPids[i]) return false;
         }
     }
     if (reader->queryCondition.nNoDomain != 0) {
         for (int i = 0; i < reader->queryCondition.nNoDomain; i++) {
             uint32_t noDomains = reader->queryCondition.noDomains[i];
-            if (((noDomains >= DOMAIN_STRICT_MASK && noDomains == reader->readPos->domain) ||
-                (noDomains <= DOMAIN_FUZZY_MASK && noDomains == (reader->readPos->domain >> DOMAIN_MODULE_BITS))))
+            if (((noDomains >= DOMAIN_STRICT_MASK && noDomains == pos->domain) ||
+                (noDomains <= DOMAIN_FUZZY_MASK && noDomains == (pos->domain >> DOMAIN_MODULE_BITS))))
                 return false;
         }
     }
     if (reader->queryCondition.nNoTag > 0) {
         for (int i = 0; i < reader->queryCondition.nNoTag; i++) {
-            if (reader->readPos->tag == reader->queryCondition.noTags[i]) return false;
+            if (pos->tag == reader->queryCondition.noTags[i]) return false;
         }
     }
-    if ((static_cast<uint8_t>((0b01 << (reader->readPos->type)) & (reader->queryCondition.noTypes)) != 0) ||
-        (static_cast<uint8_t>((0b01 << (reader->readPos->level)) & (reader->queryCondition.noLevels)) != 0)) {
+    if ((static_cast<uint8_t>((0b01 << (pos->type)) & (reader->queryCondition.noTypes)) != 0) ||
+        (static_cast<uint8_t>((0b01 << (pos->level)) & (reader->queryCondition.noLevels)) != 0)) {
         return false;
     }
+    uint64_t time = pos->tv_sec * NS_PER_SEC + pos->tv_nsec;
+    if (time < reader->queryCondition.beginTime || time > reader->queryCondition.endTime) {
+        return false;
+    }
+    /* last, it is the one check that reads the content */
+    if (reader->queryCondition.matcher != nullptr) {
+        const char *content = pos->content;
+        size_t maxLen = pos->len - pos->tag_len;
+        if (!reader->queryCondition.matcher->Match(content, strnlen(content, maxLen))) {
+            return false;
+        }
+    }
     return true;
 }
 
+/*
+ * The queries with queueLines count the records they take as they come in, so the length of a queue
+ * is known without a walk, and what the buffer lets go of is known to be lost without matching it
+ * again. Called with the buffer locked for writing.
+ */
+void HilogBuffer::CountQueued(std::list<HilogData>::iterator pos)
+{
+    for (auto &reader : queueReaders) {
+        if (!reader->GetReload() && ConditionMatch(reader, pos)) {
+            reader->pending++;
+            pos->wanted |= reader->queueMask;
+        }
+    }
+}
+
+/*
+ * What a query with queueLines asked for of the records there are when it starts gets its bit too,
+ * the bit may be left over from a query that had it before. Other readers set theirs at the same
+ * time under the shared lock, so it is done atomically. It matches every record from where the query
+ * starts to the end once, the same walk reading them takes, and writers wait for it as they do for
+ * any reader.
+ */
+void HilogBuffer::MarkWanted(const std::shared_ptr<LogReader> &reader)
+{
+    for (auto it = reader->readPos; it != hilogDataList.end(); ++it) {
+        if (ConditionMatch(reader, it)) {
+            (void)__atomic_fetch_or(&it->wanted, reader->queueMask, __ATOMIC_RELAXED);
+        } else {
+            (void)__atomic_fetch_and(&it->wanted, static_cast<uint16_t>(~reader->queueMask), __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*
+ * Whether a query with queueLines takes a record, from its bit in wanted. With all the bits in use a
+ * query goes without one and the record is matched instead, Evict then does that under the writer lock
+ * for every record it lets go ahead of the query.
+ */
+bool HilogBuffer::Wanted(const std::shared_ptr<LogReader> &reader, std::list<HilogData>::iterator pos)
+{
+    if (reader->queueMask != 0) {
+        return (pos->wanted & reader->queueMask) != 0;
+    }
+    return ConditionMatch(reader, pos);
+}
+
+/* called with the buffer locked for writing, before the record is erased */
+void HilogBuffer::UnindexRecord(std::list<HilogData>::iterator it)
+{
+    auto entry = std::lower_bound(timeIndex.begin(), timeIndex.end(), it->tv_sec,
+        [](const TimeIndexEntry &e, uint32_t sec) { return e.tv_sec < sec; });
+    for (; entry != timeIndex.end() && entry->tv_sec == it->tv_sec; ++entry) {
+        if (entry->pos == it) {
+            timeIndex.erase(entry);
+            return;
+        }
+    }
+}
+
+/* the readers there are, for a walk that looks at each of them on every record */
+std::vector<std::shared_ptr<LogReader>> HilogBuffer::GetReaders()
+{
+    std::vector<std::shared_ptr<LogReader>> readers;
+    logReaderListMutex.lock_shared();
+    for (auto &itr : logReaderList) {
+        std::shared_ptr<LogReader> reader = itr.lock();
+        if (reader != nullptr) {
+            readers.push_back(reader);
+        }
+    }
+    logReaderListMutex.unlock_shared();
+    return readers;
+}
+
+/*
+ * Readers on the record move to the one after it, called with the buffer locked for writing. A reader
+ * that got to the end goes on after lastPos, so it is on the record when that comes next.
+ */
+/* moves the readers on from a record that leaves hilogDataList, called with the buffer locked for writing */
+void HilogBuffer::Detach(std::list<HilogData>::iterator it, const std::vector<std::shared_ptr<LogReader>> &readers)
+{
+    for (auto &reader : readers) {
+        bool atEnd = (reader->readPos == hilogDataList.end());
+        if (reader->readPos == it || (atEnd && std::next(reader->lastPos) == it)) {
+            reader->readPos = std::next(it);
+        }
+        if (reader->lastPos == it) {
+            if (atEnd) {
+                /* the record after it has not been read */
+                reader->readPos = std::next(it);
+            }
+            reader->lastPos = std::next(it);
+        }
+    }
+    UnindexRecord(it);
+}
+
+std::list<HilogData>::iterator HilogBuffer::Erase(std::list<HilogData>::iterator it,
+    const std::vector<std::shared_ptr<LogReader>> &readers)
+{
+    Detach(it, readers);
+    return hilogDataList.erase(it);
+}
+
+/*
+ * Lets the oldest records of logType go until no more than limit bytes of them are left. A record a
+ * snapshot query has not passed yet is no longer counted, but moves to pinnedList until the last such
+ * query has passed it, so writers never wait for a dump to finish and no walk here sees it again. A
+ * snapshot that would keep more than MAX_PINNED_BYTES is cut. A bounded query the walk has got to
+ * loses the records it wants. Records are matched here only for cut snapshots and bounded queries
+ * without a bit, under the lock of the writer. Called with the buffer locked for writing.
+ */
+void HilogBuffer::Evict(uint16_t logType, size_t limit)
+{
+    std::vector<std::shared_ptr<LogReader>> readers = GetReaders();
+    std::vector<std::shared_ptr<LogReader>> behind; /* snapshot and bounded queries the walk has got to */
+    std::vector<std::shared_ptr<LogReader>> pinners;
+    evictEpoch++;
+    /* the snapshots mostly read in order, what they are done with is at the front */
+    for (auto &pinned : pinnedList) {
+        while (!pinned.empty() && pinned.front().pins == 0) {
+            (void)ErasePinned(pinned.begin(), readers);
+        }
+    }
+    std::list<HilogData>::iterator it = hilogDataList.begin();
+    while (sizeByType[logType] > limit && it != hilogDataList.end()) {
+        for (auto &reader : readers) {
+            /* one at the end goes on after lastPos */
+            bool at = (reader->readPos == it) ||
+                (reader->readPos == hilogDataList.end() && std::next(reader->lastPos) == it);
+            if ((reader->snapshotEnd > 0 || Bounded(reader)) && at &&
+                std::find(behind.begin(), behind.end(), reader) == behind.end()) {
+                behind.push_back(reader);
+            }
+        }
+        if (it->type != logType) {    // Only remove old logs of the same type
+            ++it;
+            continue;
+        }
+        size_t cLen = it->len - it->tag_len;
+        size -= cLen;
+        sizeByType[logType] -= cLen;
+        pinners.clear();
+        for (auto &reader : behind) {
+            if (it->seq < reader->snapshotEnd && !reader->pinCut &&
+                reader->pinnedBytes + cLen > MAX_PINNED_BYTES) {
+                CutPins(reader);
+            }
+            if (it->seq < reader->snapshotEnd && !reader->pinCut) {
+                pinners.push_back(reader);
+                reader->pinnedBytes += cLen;
+            } else if (it->seq < reader->snapshotEnd && ConditionMatch(reader, it)) {
+                /* gone before the cut snapshot got to it */
+                reader->lostLines++;
+            }
+            if (Bounded(reader) && Wanted(reader, it)) {
+                /* gone before the reader got to it */
+                if (it->seq >= reader->startSeq && reader->pending > 0) {
+                    reader->pending--;
+                }
+                reader->lostLines++;
+            }
+        }
+        if (pinners.empty()) {
+            it = Erase(it, readers);
+            continue;
+        }
+        std::list<HilogData>::iterator next = std::next(it);
+        it->evictEpoch = evictEpoch;
+        it->pins = static_cast<uint16_t>(pinners.size());
+        Pin(it, readers, pinners);
+        it = next;
+    }
+}
+
+/*
+ * Moves a record let go to its place in pinnedList, the snapshots that pin it look at it next if it comes
+ * first. Records of one type are let go in the order of the list, it goes at the end but for one that
+ * came in late with an older time.
+ */
+void HilogBuffer::Pin(std::list<HilogData>::iterator it, const std::vector<std::shared_ptr<LogReader>> &readers,
+    const std::vector<std::shared_ptr<LogReader>> &pinners)
+{
+    Detach(it, readers);
+    std::list<HilogData> &pinned = pinnedList[it->type];
+    std::list<HilogData>::iterator at = pinned.end();
+    while (at != pinned.begin() && Before(*it, *std::prev(at))) {
+        --at;
+    }
+    pinned.splice(at, hilogDataList, it);
+    for (auto &reader : pinners) {
+        std::list<HilogData>::iterator &pinPos = reader->pinPos[it->type];
+        if (pinPos == pinned.end() || Before(*it, *pinPos)) {
+            pinPos = it;
+        }
+    }
+}
+
+/* a pinned record nobody needs any more, the snapshots that would look at it next go on after it */
+std::list<HilogData>::iterator HilogBuffer::ErasePinned(std::list<HilogData>::iterator it,
+    const std::vector<std::shared_ptr<LogReader>> &readers)
+{
+    for (auto &reader : readers) {
+        if (reader->snapshotEnd > 0 && reader->pinPos[it->type] == it) {
+            reader->pinPos[it->type] = std::next(it);
+        }
+    }
+    return pinnedList[it->type].erase(it);
+}
+
+/* the type whose pinned record a snapshot comes to first, LOG_TYPE_MAX when it has none left */
+uint16_t HilogBuffer::NextPinned(const std::shared_ptr<LogReader> &reader)
+{
+    uint16_t next = LOG_TYPE_MAX;
+    for (uint16_t type = 0; type < LOG_TYPE_MAX; type++) {
+        if (reader->pinPos[type] != pinnedList[type].end() &&
+            (next == LOG_TYPE_MAX || Before(*reader->pinPos[type], *reader->pinPos[next]))) {
+            next = type;
+        }
+    }
+    return next;
+}
+
+/* a record evicted after the snapshot of the query was taken, and before the query read it */
+bool HilogBuffer::Pinned(std::shared_ptr<LogReader> reader, std::list<HilogData>::iterator pos)
+{
+    return reader->snapshotEnd > 0 && !reader->pinCut && pos->evictEpoch > reader->pinEpoch &&
+        pos->seq < reader->snapshotEnd;
+}
+
+/*
+ * A snapshot that keeps MAX_PINNED_BYTES let go for it, as one whose client does not read does, gives
+ * them up and pins no more. What it has not read of them is lost, and so is what goes ahead of it later.
+ * Called with the buffer locked for writing.
+ */
+void HilogBuffer::CutPins(std::shared_ptr<LogReader> reader)
+{
+    for (uint16_t type = 0; type < LOG_TYPE_MAX; type++) {
+        for (auto it = reader->pinPos[type]; it != pinnedList[type].end(); ++it) {
+            if (Pinned(reader, it)) {
+                it->pins--;
+                if (ConditionMatch(reader, it)) {
+                    reader->lostLines++;
+                }
+            }
+        }
+        reader->pinPos[type] = pinnedList[type].end();
+    }
+    reader->pinCut = true;
+    reader->pinnedBytes = 0;
+}
+
+/* a snapshot query going away lets go of what it has not read, and the records nobody needs are erased */
+void HilogBuffer::Unpin(std::shared_ptr<LogReader> reader)
+{
+    hilogBufferMutex.lock();
+    std::vector<std::shared_ptr<LogReader>> readers = GetReaders();
+    for (uint16_t type = 0; type < LOG_TYPE_MAX; type++) {
+        for (auto it = reader->pinPos[type]; it != pinnedList[type].end(); ++it) {
+            if (Pinned(reader, it)) {
+                it->pins--;
+            }
+        }
+        reader->pinPos[type] = pinnedList[type].end();
+    }
+    reader->snapshotEnd = 0;
+    for (auto &pinned : pinnedList) {
+        std::list<HilogData>::iterator it = pinned.begin();
+        while (it != pinned.end()) {
+            it = (it->pins == 0) ? ErasePinned(it, readers) : std::next(it);
+        }
+    }
+    hilogBufferMutex.unlock();
+}
+
+/* the first record of tv_sec or later, called with the buffer locked */
+std::list<HilogData>::iterator HilogBuffer::SeekTime(uint32_t tv_sec)
+{
+    auto entry = std::lower_bound(timeIndex.begin(), timeIndex.end(), tv_sec,
+        [](const TimeIndexEntry &e, uint32_t sec) { return e.tv_sec < sec; });
+    std::list<HilogData>::iterator it = hilogDataList.begin();
+    if (entry != timeIndex.begin()) {
+        it = std::prev(entry)->pos;
+    }
+    while (it != hilogDataList.end() && it->tv_sec < tv_sec) {
+        ++it;
+    }
+    return it;
+}
+
+/*
+ * Where the last tailCount records the reader takes begin, found from the end backwards. Nothing
+ * before from is looked at, the reader would not take it.
+ */
+std::list<HilogData>::iterator HilogBuffer::SeekTail(std::shared_ptr<LogReader> reader,
+    std::list<HilogData>::iterator from)
+{
+    std::list<HilogData>::iterator it = hilogDataList.end();
+    uint32_t found = 0;
+    while (it != from && found < reader->queryCondition.tailCount) {
+        --it;
+        if (ConditionMatch(reader, it)) {
+            found++;
+        }
+    }
+    return it;
+}
+
+/*
+ * The records a reader has not passed yet that came in after its query started and that it takes are
+ * its queue, the ones there were before are what it asked for. When the queue holds more than
+ * queueLines the drop policy of the query says which go. False once the reader is to be disconnected.
+ * Called with the buffer locked.
+ */
+bool HilogBuffer::TrimQueue(std::shared_ptr<LogReader> reader)
+{
+    if (reader->readPos == hilogDataList.end() || reader->readPos->seq < reader->dropEnd) {
+        /* nothing waits, or the records to drop are picked already and it has not got past them */
+        return true;
+    }
+    uint32_t limit = reader->queryCondition.queueLines;
+    if (reader->pending <= limit) {
+        return true;
+    }
+    switch (reader->queryCondition.dropPolicy) {
+        case QUEUE_DROP_NEWEST: {
+            /* the newest it takes go, found from the end backwards */
+            uint32_t excess = reader->pending - limit;
+            std::list<HilogData>::iterator it = hilogDataList.end();
+            while (excess > 0 && it != reader->readPos) {
+                --it;
+                if (it->seq >= reader->startSeq && ConditionMatch(reader, it)) {
+                    excess--;
+                }
+            }
+            reader->dropBegin = std::max(reader->startSeq, it->seq);
+            reader->dropEnd = nextSeq;
+            return true;
+        }
+        case QUEUE_DISCONNECT:
+            for (auto it = reader->readPos; it != hilogDataList.end(); ++it) {
+                if (ConditionMatch(reader, it)) {
+                    reader->lostLines++;
+                }
+            }
+            reader->WriteLoss(reader->lostLines, true);
+            reader->lostLines = 0;
+            reader->pending = 0;
+            return false;
+        default:
+            while (reader->readPos != hilogDataList.end() && reader->pending > limit) {
+                if (ConditionMatch(reader, reader->readPos)) {
+                    reader->lostLines++;
+                    if (reader->readPos->seq >= reader->startSeq) {
+                        reader->pending--;
+                    }
+                }
+                reader->lastPos = reader->readPos;
+                reader->readPos++;
+            }
+            return true;
+    }
+}
+
+/* what was dropped goes to the reader before the record after it */
+void HilogBuffer::ReportLoss(std::shared_ptr<LogReader> reader)
+{
+    if (reader->lostLines > 0) {
+        reader->WriteLoss(reader->lostLines, false);
+        reader->lostLines = 0;
+    }
+}
+
+/* readers share the buffer lock, what they print is counted under a lock of its own */
+void HilogBuffer::CountPrinted(const HilogData &data)
+{
+    size_t len = strlen(data.content);
+    std::lock_guard<std::mutex> guard(statisticMutex);
+    printLenByType[data.type] += len;
+    printLenByDomain[data.domain] += len;
+}
+
 void HilogBuffer::ReturnNoLog(std::shared_ptr<LogReader> reader)
 {
     reader->SetSendId(SENDIDN);
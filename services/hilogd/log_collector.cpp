@@ -108,8 +108,9 @@ size_t LogCollector::InsertLogToBuffer(const HilogMsg& msg)
     hilogBuffer->logReaderListMutex.lock_shared();
     auto it = hilogBuffer->logReaderList.begin();
     while (it != hilogBuffer->logReaderList.end()) {
-        if ((*it).lock()->GetType() != TYPE_CONTROL) {
-            (*it).lock()->NotifyForNewData();
+        std::shared_ptr<LogReader> reader = (*it).lock();
+        if (reader != nullptr && reader->GetType() != TYPE_CONTROL) {
+            reader->NotifyForNewData();
         }
         ++it;
     }
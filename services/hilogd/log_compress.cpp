@@ -22,159 +22,177 @@
 using namespace std;
 namespace OHOS {
 namespace HiviewDFX {
+static constexpr uint32_t ZLIB_FLUSH_MARGIN = 16;
+static constexpr uint32_t ZSTD_FLUSH_MARGIN = 32;
+
 LogCompress::LogCompress()
 {
 }
 
-void LogCompress::DeleteZData()
+int LogCompress::Finish(LogCompressBuffer* &compressBuffer)
 {
-    delete zdata;
-    zdata = nullptr;
+    return 0;
 }
 
-int NoneCompress::Compress(LogPersisterBuffer* &buffer, LogPersisterBuffer* &compressBuffer)
+int NoneCompress::Compress(const char *src, uint32_t srcLen, LogCompressBuffer* &compressBuffer)
 {
-    if (memcpy_s(compressBuffer->content, compressBuffer->offset, buffer->content, buffer->offset) != 0) {
+    if (memcpy_s(compressBuffer->content + compressBuffer->offset,
+        MAX_COMPRESS_BUFFER_SIZE - compressBuffer->offset, src, srcLen) != 0) {
         return -1;
     }
+    compressBuffer->offset += srcLen;
     return 0;
 }
 
-int ZlibCompress::Compress(LogPersisterBuffer* &buffer, LogPersisterBuffer* &compressBuffer)
+ZlibCompress::~ZlibCompress()
 {
-    uint32_t zdlen = compressBound(buffer->offset);
-    zdata = new unsigned char [zdlen];
-    if (zdata == nullptr) {
-        cout << "no enough memory!" << endl;
-        return -1;
+    if (isStreamInit) {
+        (void)deflateEnd(&cStream);
+    }
+}
+
+int ZlibCompress::InitStream()
+{
+    if (isStreamInit) {
+        return 0;
     }
-    size_t const toRead = CHUNK;
-    auto src_pos = 0;
-    auto dst_pos = 0;
-    size_t read = buffer->offset;
-    int flush = 0;
     cStream.zalloc = Z_NULL;
     cStream.zfree = Z_NULL;
     cStream.opaque = Z_NULL;
     if (deflateInit2(&cStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
-        DeleteZData();
         return -1;
     }
-    do {
-        bool flag = read - src_pos < toRead;
-        if (flag) {
-            memset_s(buffIn, CHUNK, 0, CHUNK);
-            if (memmove_s(buffIn, CHUNK, buffer->content + src_pos, read - src_pos) != 0) {
-                DeleteZData();
-                return -1;
-            }
-            cStream.avail_in = read - src_pos;
-            src_pos += read - src_pos;
-        } else {
-            memset_s(buffIn, CHUNK, 0, CHUNK);
-            if (memmove_s(buffIn, CHUNK, buffer->content + src_pos, toRead) != 0) {
-                DeleteZData();
-                return -1;
-            };
-            src_pos += toRead;
-            cStream.avail_in = toRead;
-        }
-        flush = flag ? Z_FINISH : Z_NO_FLUSH;
-        cStream.next_in = (Bytef *)buffIn;
-        /* run deflate() on input until output buffer not full, finish
-           compression if all of source has been read in */
-        do {
-            cStream.avail_out = CHUNK;
-            cStream.next_out = (Bytef *)buffOut;
-            if (deflate(&cStream, flush) == Z_STREAM_ERROR) {
-                DeleteZData();
-                return -1;
-            }
-            unsigned have = CHUNK - cStream.avail_out;
-            if (memmove_s(zdata + dst_pos, CHUNK, buffOut, have) != 0) {
-                DeleteZData();
-                return -1;
-            }
-            dst_pos += have;
-        } while (cStream.avail_out == 0);
-    } while (flush != Z_FINISH);
-    /* clean up and return */
-    (void)deflateEnd(&cStream);
-    if (memcpy_s(compressBuffer->content + compressBuffer->offset,
-        MAX_PERSISTER_BUFFER_SIZE - compressBuffer->offset, zdata, dst_pos) != 0) {
-        DeleteZData();
+    isStreamInit = true;
+    return 0;
+}
+
+int ZlibCompress::Deflate(const char *src, uint32_t srcLen, int flush, LogCompressBuffer* &compressBuffer)
+{
+    uint32_t outLen = MAX_COMPRESS_BUFFER_SIZE - compressBuffer->offset;
+    /* deflateBound covers the stream header and trailer, the margin the sync flush marker */
+    if (deflateBound(&cStream, srcLen) + ZLIB_FLUSH_MARGIN > outLen) {
+        ResetStream();
+        return -1;
+    }
+    cStream.next_in = (Bytef *)src;
+    cStream.avail_in = srcLen;
+    cStream.next_out = (Bytef *)(compressBuffer->content + compressBuffer->offset);
+    cStream.avail_out = outLen;
+    int ret = deflate(&cStream, flush);
+    /* a full output buffer means the flush may not have completed */
+    if (ret == Z_STREAM_ERROR || cStream.avail_in != 0 ||
+        ((flush == Z_FINISH) ? (ret != Z_STREAM_END) : (cStream.avail_out == 0))) {
+        ResetStream();
         return -1;
     }
-    compressBuffer->offset += dst_pos;
-    DeleteZData();
+    compressBuffer->offset += outLen - cStream.avail_out;
     return 0;
 }
 
-int ZstdCompress::Compress(LogPersisterBuffer* &buffer, LogPersisterBuffer* &compressBuffer)
+/* the member is left unfinished, what was produced of it is dropped and the next call starts a new one */
+void ZlibCompress::ResetStream()
 {
-#ifdef USING_ZSTD_COMPRESS
-    uint32_t zdlen = ZSTD_CStreamOutSize();
-    zdata = new unsigned char [zdlen];
-    if (zdata == nullptr) {
-        cout << "no enough memory!" << endl;
+    (void)deflateReset(&cStream);
+    cout << "ZlibCompress: stream reset" << endl;
+}
+
+int ZlibCompress::Compress(const char *src, uint32_t srcLen, LogCompressBuffer* &compressBuffer)
+{
+    if (InitStream() != 0) {
         return -1;
     }
-    ZSTD_EndDirective mode;
+    /* sync flush keeps everything written so far decompressible if the member is never finished */
+    return Deflate(src, srcLen, Z_SYNC_FLUSH, compressBuffer);
+}
+
+int ZlibCompress::Finish(LogCompressBuffer* &compressBuffer)
+{
+    if (!isStreamInit) {
+        return 0;
+    }
+    int ret = Deflate(nullptr, 0, Z_FINISH, compressBuffer);
+    (void)deflateReset(&cStream);
+    return ret;
+}
+
+ZstdCompress::~ZstdCompress()
+{
+#ifdef USING_ZSTD_COMPRESS
+    ZSTD_freeCCtx(cctx);
+    cctx = nullptr;
+#endif
+}
+
+#ifdef USING_ZSTD_COMPRESS
+int ZstdCompress::InitStream()
+{
+    if (cctx != nullptr) {
+        return 0;
+    }
     int compressionlevel = 1;
     cctx = ZSTD_createCCtx();
     if (cctx == nullptr) {
         cout << "ZSTD_createCCtx() failed!" << endl;
-        DeleteZData();
         return -1;
     }
     ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, compressionlevel);
-    size_t const toRead = CHUNK;
-    auto src_pos = 0;
-    auto dst_pos = 0;
-    size_t read = buffer->offset;
-    ZSTD_inBuffer input;
+    return 0;
+}
+
+int ZstdCompress::Stream(const char *src, uint32_t srcLen, ZSTD_EndDirective mode,
+    LogCompressBuffer* &compressBuffer)
+{
+    ZSTD_inBuffer input = {src, srcLen, 0};
+    ZSTD_outBuffer output = {compressBuffer->content + compressBuffer->offset,
+        MAX_COMPRESS_BUFFER_SIZE - compressBuffer->offset, 0};
+    /* ZSTD_compressBound covers a whole frame, the margin the block header of the flush and the checksum */
+    if (ZSTD_compressBound(srcLen) + ZSTD_FLUSH_MARGIN > output.size) {
+        ResetStream();
+        return -1;
+    }
+    size_t remaining;
     do {
-        bool flag = read - src_pos < toRead;
-        if (flag) {
-            memset_s(buffIn, CHUNK, 0, CHUNK);
-            if (memmove_s(buffIn, CHUNK, buffer->content + src_pos, read - src_pos) != 0) {
-                DeleteZData();
-                return -1;
-            }
-            input = {buffIn, read - src_pos, 0};
-            src_pos += read - src_pos;
-        } else {
-            memset_s(buffIn, CHUNK, 0, CHUNK);
-            if (memmove_s(buffIn, CHUNK, buffer->content + src_pos, toRead) != 0) {
-                DeleteZData();
-                return -1;
-            }
-            input = {buffIn, toRead, 0};
-            src_pos += toRead;
-        }
-        mode = flag ? ZSTD_e_end : ZSTD_e_continue;
-        int finished;
-        do {
-            ZSTD_outBuffer output = {buffOut, CHUNK, 0};
-            size_t const remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
-            if (memmove_s(zdata + dst_pos, zdlen, (Bytef *)buffOut, output.pos) != 0) {
-                DeleteZData();
-                return -1;
-            }
-            dst_pos += output.pos;
-            finished = flag ? (remaining == 0) : (input.pos == input.size);
-        } while (!finished);
-    } while (mode != ZSTD_e_end);
-    ZSTD_freeCCtx(cctx);
-    if (memcpy_s(compressBuffer->content + compressBuffer->offset,
-        MAX_PERSISTER_BUFFER_SIZE - compressBuffer->offset, zdata, dst_pos) != 0) {
-        DeleteZData();
+        remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+    } while (!ZSTD_isError(remaining) && remaining != 0 && output.pos < output.size);
+    if (ZSTD_isError(remaining) || remaining != 0 || input.pos != input.size) {
+        ResetStream();
+        return -1;
+    }
+    compressBuffer->offset += output.pos;
+    return 0;
+}
+
+/* the frame is left unfinished, what was produced of it is dropped and the next call starts a new one */
+void ZstdCompress::ResetStream()
+{
+    (void)ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+    cout << "ZstdCompress: stream reset" << endl;
+}
+#endif // #ifdef USING_ZSTD_COMPRESS
+
+int ZstdCompress::Compress(const char *src, uint32_t srcLen, LogCompressBuffer* &compressBuffer)
+{
+#ifdef USING_ZSTD_COMPRESS
+    if (InitStream() != 0) {
         return -1;
     }
-    compressBuffer->offset += dst_pos;
-    DeleteZData();
+    /* flush ends a block, everything written so far is decodable even if the frame is never ended */
+    return Stream(src, srcLen, ZSTD_e_flush, compressBuffer);
+#else
+    return 0;
 #endif // #ifdef USING_ZSTD_COMPRESS
+}
+
+int ZstdCompress::Finish(LogCompressBuffer* &compressBuffer)
+{
+#ifdef USING_ZSTD_COMPRESS
+    if (cctx == nullptr) {
+        return 0;
+    }
+    return Stream(nullptr, 0, ZSTD_e_end, compressBuffer);
+#else
     return 0;
+#endif // #ifdef USING_ZSTD_COMPRESS
 }
 }
 }
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "log_io_engine.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <securec.h>
+#ifdef HILOG_PERSIST_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+namespace OHOS {
+namespace HiviewDFX {
+using namespace std;
+
+struct LogIoRequest {
+    LogIoTracker *tracker;
+    int fd;
+    uint64_t offset; /* what the sync makes durable */
+};
+
+void LogIoTracker::Add()
+{
+    std::lock_guard<mutex> guard(lock);
+    inflight++;
+}
+
+void LogIoTracker::Done(int err, uint64_t synced)
+{
+    std::lock_guard<mutex> guard(lock);
+    if (err != 0 && error == 0) {
+        error = err;
+    }
+    if (err == 0 && synced > syncedOffset) {
+        syncedOffset = synced;
+    }
+    inflight--;
+}
+
+bool LogIoTracker::Busy()
+{
+    std::lock_guard<mutex> guard(lock);
+    return inflight > 0;
+}
+
+int LogIoTracker::TakeError()
+{
+    std::lock_guard<mutex> guard(lock);
+    int ret = error;
+    error = 0;
+    return ret;
+}
+
+void LogIoTracker::Abandon(int err)
+{
+    std::lock_guard<mutex> guard(lock);
+    if (error == 0) {
+        error = err;
+    }
+    inflight = 0;
+}
+
+uint64_t LogIoTracker::Synced()
+{
+    std::lock_guard<mutex> guard(lock);
+    return syncedOffset;
+}
+
+void LogIoTracker::Reset()
+{
+    std::lock_guard<mutex> guard(lock);
+    error = 0;
+    syncedOffset = 0;
+}
+
+LogIoEngine& LogIoEngine::GetInstance()
+{
+    /* never destroyed, requests may still be in flight when hilogd exits */
+    static LogIoEngine *engine = new LogIoEngine();
+    return *engine;
+}
+
+LogIoEngine::LogIoEngine()
+{
+    (void)Setup();
+}
+
+bool LogIoEngine::Available() const
+{
+    return ringFd >= 0 && !broken.load(memory_order_relaxed);
+}
+
+#ifdef HILOG_PERSIST_IO_URING
+template<typename T>
+static T *RingField(void *ring, uint32_t offset)
+{
+    return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+}
+
+int LogIoEngine::Setup()
+{
+    struct io_uring_params params;
+    (void)memset_s(&params, sizeof(params), 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, LOG_IO_RING_ENTRIES, &params));
+    if (fd < 0) {
+        cout << "io_uring is not available, " << strerror(errno) << ", persisters sync on their own" << endl;
+        return RET_FAIL;
+    }
+    size_t sqLen = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqLen = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sqLen = (cqLen > sqLen) ? cqLen : sqLen;
+        cqLen = sqLen;
+    }
+    void *sq = mmap(nullptr, sqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    void *cq = sq;
+    if (sq != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(nullptr, cqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    void *sqeArray = mmap(nullptr, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqeArray == MAP_FAILED) {
+        close(fd);
+        return RET_FAIL;
+    }
+    sqHead = RingField<unsigned>(sq, params.sq_off.head);
+    sqTail = RingField<unsigned>(sq, params.sq_off.tail);
+    sqMask = RingField<unsigned>(sq, params.sq_off.ring_mask);
+    sqArray = RingField<unsigned>(sq, params.sq_off.array);
+    cqHead = RingField<unsigned>(cq, params.cq_off.head);
+    cqTail = RingField<unsigned>(cq, params.cq_off.tail);
+    cqMask = RingField<unsigned>(cq, params.cq_off.ring_mask);
+    cqes = RingField<void>(cq, params.cq_off.cqes);
+    sqes = sqeArray;
+    entries = params.sq_entries;
+    ringFd = fd;
+    return RET_SUCCESS;
+}
+
+void LogIoEngine::Fail(int err)
+{
+    /* whatever is still in flight is given up, the jobs sync on their own from now on */
+    if (!broken.exchange(true)) {
+        cout << "io_uring failed " << strerror(err) << ", persisters sync on their own" << endl;
+    }
+}
+
+int LogIoEngine::Enter(uint32_t toSubmit, uint32_t minComplete)
+{
+    unsigned flags = (minComplete > 0) ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+    do {
+        ret = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+    } while (ret < 0 && errno == EINTR);
+    if (ret >= 0 || errno == EAGAIN || errno == EBUSY) {
+        /* out of resources for now, what is left in the ring goes with the next call */
+        return (ret < 0) ? 0 : ret;
+    }
+    Fail(errno);
+    return RET_FAIL;
+}
+
+uint32_t LogIoEngine::SubmitQueued()
+{
+    std::lock_guard<mutex> guard(lock);
+    unsigned pending = *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (pending > 0 && Enter(pending, 0) > 0) {
+        pending = *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    }
+    return pending;
+}
+
+uint32_t LogIoEngine::Reap()
+{
+    if (broken) {
+        return 0;
+    }
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return 0;
+    }
+    {
+        /* the lock also orders the reads of the requests after the Queue that wrote them */
+        std::lock_guard<mutex> guard(lock);
+        inflight -= tail - head;
+    }
+    uint32_t reaped = 0;
+    for (; head != tail; head++, reaped++) {
+        struct io_uring_cqe *cqe = static_cast<struct io_uring_cqe *>(cqes) + (head & *cqMask);
+        Complete(reinterpret_cast<LogIoRequest *>(cqe->user_data), cqe->res);
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+void LogIoEngine::Progress()
+{
+    /* called with reapLock held, completes at least one request unless the ring failed */
+    uint32_t pending = SubmitQueued();
+    if (Reap() > 0 || broken) {
+        return;
+    }
+    if (pending > 0) {
+        /* the kernel took none of them, it may have nothing to complete either */
+        this_thread::yield();
+        return;
+    }
+    {
+        std::lock_guard<mutex> guard(lock);
+        if (inflight == *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE)) {
+            /* none is with the kernel, whoever reaped before us completed them all */
+            return;
+        }
+    }
+    (void)Enter(0, 1);
+}
+
+/* every request is an fdatasync, the only op the ring carries */
+int LogIoEngine::Queue(LogIoRequest *request)
+{
+    std::unique_lock<mutex> lk(lock);
+    /* queued requests count as in flight, so this leaves room in both rings */
+    while (inflight >= entries) {
+        lk.unlock();
+        {
+            std::lock_guard<mutex> guard(reapLock);
+            Progress();
+        }
+        if (broken) {
+            return RET_FAIL;
+        }
+        lk.lock();
+    }
+    unsigned tail = *sqTail;
+    unsigned idx = tail & *sqMask;
+    struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(sqes) + idx;
+    (void)memset_s(sqe, sizeof(*sqe), 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = request->fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+    sqArray[idx] = idx;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    inflight++;
+    return RET_SUCCESS;
+}
+
+void LogIoEngine::Submit()
+{
+    if (!Available()) {
+        return;
+    }
+    (void)SubmitQueued();
+    /* whoever already completes requests does it for us as well */
+    if (reapLock.try_lock()) {
+        (void)Reap();
+        reapLock.unlock();
+    }
+}
+
+int LogIoEngine::Wait(LogIoTracker &tracker)
+{
+    if (ringFd < 0) {
+        return tracker.TakeError();
+    }
+    std::lock_guard<mutex> guard(reapLock);
+    while (tracker.Busy()) {
+        if (broken) {
+            /* the ring will not complete them any more, the buffers stay with the kernel */
+            tracker.Abandon(EIO);
+            break;
+        }
+        Progress();
+    }
+    return tracker.TakeError();
+}
+
+void LogIoEngine::Complete(LogIoRequest *request, int res)
+{
+    if (res < 0) {
+        cout << "io_uring sync of fd " << request->fd << " failed " << strerror(-res) << endl;
+    }
+    request->tracker->Done((res < 0) ? -res : 0, request->offset);
+    delete request;
+}
+
+int LogIoEngine::Sync(int fd, uint64_t offset, LogIoTracker &tracker)
+{
+    if (!Available()) {
+        return RET_FAIL;
+    }
+    LogIoRequest *request = new LogIoRequest;
+    request->tracker = &tracker;
+    request->fd = fd;
+    request->offset = offset;
+    tracker.Add();
+    if (Queue(request) != RET_SUCCESS) {
+        tracker.Done(0, 0);
+        delete request;
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+#else
+int LogIoEngine::Setup()
+{
+    return RET_FAIL;
+}
+
+int LogIoEngine::Sync(int, uint64_t, LogIoTracker &)
+{
+    return RET_FAIL;
+}
+
+void LogIoEngine::Submit()
+{
+}
+
+int LogIoEngine::Wait(LogIoTracker &tracker)
+{
+    return tracker.TakeError();
+}
+#endif
+} // namespace HiviewDFX
+} // namespace OHOS
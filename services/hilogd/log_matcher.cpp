@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "log_matcher.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <cstring>
+#include <map>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace OHOS {
+namespace HiviewDFX {
+using namespace std;
+using ByteSet = bitset<256>;
+
+namespace {
+const char META_CHARS[] = "\\^$.|?*+()[]{}";
+
+struct NfaState {
+    bool hasChars = false;
+    ByteSet chars;
+    int target = -1;   /* where a byte of chars leads */
+    vector<int> eps;
+};
+
+struct Fragment {
+    int start;
+    int end; /* has only epsilon edges, the fragment that follows is hooked on to them */
+};
+
+/*
+ * Thompson construction of the part of ECMAScript the matcher takes. Any construct outside of it
+ * fails the parse, rather than be matched differently from std::regex.
+ */
+class PatternParser {
+public:
+    explicit PatternParser(const string &pattern) : pattern(pattern) {}
+    bool Parse(Fragment &frag)
+    {
+        return ParseAlternation(frag) && pos == pattern.size();
+    }
+    vector<NfaState> states;
+    bool hasAlternation = false;
+private:
+    int NewState()
+    {
+        states.emplace_back();
+        return static_cast<int>(states.size()) - 1;
+    }
+    Fragment CharFragment(const ByteSet &chars)
+    {
+        Fragment frag = {NewState(), NewState()};
+        states[frag.start].hasChars = true;
+        states[frag.start].chars = chars;
+        states[frag.start].target = frag.end;
+        return frag;
+    }
+    bool ParseAlternation(Fragment &frag)
+    {
+        if (!ParseConcat(frag)) {
+            return false;
+        }
+        while (pos < pattern.size() && pattern[pos] == '|') {
+            pos++;
+            hasAlternation = true;
+            Fragment right;
+            if (!ParseConcat(right)) {
+                return false;
+            }
+            Fragment alt = {NewState(), NewState()};
+            states[alt.start].eps = {frag.start, right.start};
+            states[frag.end].eps.push_back(alt.end);
+            states[right.end].eps.push_back(alt.end);
+            frag = alt;
+        }
+        return true;
+    }
+    bool ParseConcat(Fragment &frag)
+    {
+        int empty = NewState();
+        frag = {empty, empty};
+        while (pos < pattern.size() && pattern[pos] != '|' && pattern[pos] != ')') {
+            Fragment item;
+            if (!ParseRepeat(item)) {
+                return false;
+            }
+            states[frag.end].eps.push_back(item.start);
+            frag.end = item.end;
+        }
+        return true;
+    }
+    bool ParseRepeat(Fragment &frag)
+    {
+        if (!ParseAtom(frag)) {
+            return false;
+        }
+        if (pos == pattern.size() || strchr("*+?", pattern[pos]) == nullptr) {
+            return true;
+        }
+        char quantifier = pattern[pos++];
+        if (pos < pattern.size() && pattern[pos] == '?') {
+            pos++; /* lazy, it makes no difference to whether there is a match */
+        }
+        if (pos < pattern.size() && strchr("*+?{", pattern[pos]) != nullptr) {
+            return false;
+        }
+        Fragment rep = {NewState(), NewState()};
+        states[rep.start].eps.push_back(frag.start);
+        if (quantifier != '+') {
+            states[rep.start].eps.push_back(rep.end);
+        }
+        if (quantifier != '?') {
+            states[frag.end].eps.push_back(frag.start);
+        }
+        states[frag.end].eps.push_back(rep.end);
+        frag = rep;
+        return true;
+    }
+    bool ParseAtom(Fragment &frag)
+    {
+        char c = pattern[pos++];
+        ByteSet chars;
+        switch (c) {
+            case '(':
+                if (pattern.compare(pos, 2, "?:") == 0) {
+                    pos += 2;
+                } else if (pos < pattern.size() && pattern[pos] == '?') {
+                    return false;
+                }
+                if (!ParseAlternation(frag) || pos == pattern.size() || pattern[pos] != ')') {
+                    return false;
+                }
+                pos++;
+                return true;
+            case '[':
+                if (!ParseClass(chars)) {
+                    return false;
+                }
+                break;
+            case '.':
+                chars.set();
+                chars.reset('\n');
+                chars.reset('\r');
+                break;
+            case '\\':
+                if (!ParseEscape(chars)) {
+                    return false;
+                }
+                break;
+            default:
+                if (strchr(META_CHARS, c) != nullptr) {
+                    return false;
+                }
+                chars.set(static_cast<uint8_t>(c));
+                break;
+        }
+        frag = CharFragment(chars);
+        return true;
+    }
+    bool ParseEscape(ByteSet &chars)
+    {
+        if (pos == pattern.size()) {
+            return false;
+        }
+        uint8_t c = static_cast<uint8_t>(pattern[pos++]);
+        ByteSet digits;
+        for (int i = '0'; i <= '9'; i++) {
+            digits.set(i);
+        }
+        ByteSet words = digits;
+        for (int i = 0; i < 26; i++) {
+            words.set('a' + i);
+            words.set('A' + i);
+        }
+        words.set('_');
+        ByteSet spaces;
+        for (const char *s = " \t\n\v\f\r"; *s != 0; s++) {
+            spaces.set(static_cast<uint8_t>(*s));
+        }
+        switch (c) {
+            case 'd': chars |= digits; return true;
+            case 'D': chars |= ~digits; return true;
+            case 'w': chars |= words; return true;
+            case 'W': chars |= ~words; return true;
+            case 's': chars |= spaces; return true;
+            case 'S': chars |= ~spaces; return true;
+            case 't': chars.set('\t'); return true;
+            case 'n': chars.set('\n'); return true;
+            case 'r': chars.set('\r'); return true;
+            case 'f': chars.set('\f'); return true;
+            case 'v': chars.set('\v'); return true;
+            default:
+                break;
+        }
+        /* only punctuation stands for itself, \b \1 \x41 \cJ and the like are not taken */
+        if (c >= 0x80 || isalnum(c)) {
+            return false;
+        }
+        chars.set(c);
+        return true;
+    }
+    /* one member of a class, single is false for \d and the like */
+    bool ParseClassItem(ByteSet &chars, uint8_t &single, bool &isSingle)
+    {
+        char c = pattern[pos++];
+        if (c == '[') {
+            return false;
+        }
+        if (c != '\\') {
+            single = static_cast<uint8_t>(c);
+            isSingle = true;
+            chars.set(single);
+            return true;
+        }
+        ByteSet escaped;
+        if (!ParseEscape(escaped)) {
+            return false;
+        }
+        isSingle = (escaped.count() == 1);
+        if (isSingle) {
+            for (single = 0; !escaped.test(single); single++) {
+            }
+        }
+        chars |= escaped;
+        return true;
+    }
+    bool ParseClass(ByteSet &chars)
+    {
+        bool negate = (pos < pattern.size() && pattern[pos] == '^');
+        if (negate) {
+            pos++;
+        }
+        if (pos == pattern.size() || pattern[pos] == ']') {
+            return false;
+        }
+        while (pos < pattern.size() && pattern[pos] != ']') {
+            uint8_t low = 0;
+            bool lowSingle = false;
+            ByteSet item;
+            if (!ParseClassItem(item, low, lowSingle)) {
+                return false;
+            }
+            if (pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos + 1] != ']') {
+                pos++;
+                uint8_t high = 0;
+                bool highSingle = false;
+                ByteSet ignored;
+                if (!lowSingle || !ParseClassItem(ignored, high, highSingle) || !highSingle ||
+                    low > high || high >= 0x80) {
+                    return false;
+                }
+                for (uint32_t i = low; i <= high; i++) {
+                    chars.set(i);
+                }
+                continue;
+            }
+            chars |= item;
+        }
+        if (pos == pattern.size()) {
+            return false;
+        }
+        pos++;
+        if (negate) {
+            chars.flip();
+        }
+        return true;
+    }
+    const string &pattern;
+    size_t pos = 0;
+};
+
+void Closure(const vector<NfaState> &states, vector<int> &set, vector<uint32_t> &seen, uint32_t stamp)
+{
+    vector<int> stack(set);
+    set.clear();
+    for (int s : stack) {
+        seen[s] = stamp;
+    }
+    while (!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+        set.push_back(s);
+        for (int e : states[s].eps) {
+            if (seen[e] != stamp) {
+                seen[e] = stamp;
+                stack.push_back(e);
+            }
+        }
+    }
+}
+} // namespace
+
+unique_ptr<LogMatcher> LogMatcher::Create(const string &pattern)
+{
+    unique_ptr<LogMatcher> matcher(new LogMatcher());
+    if (pattern.find_first_of(META_CHARS) == string::npos) {
+        matcher->isLiteral = true;
+        matcher->literal = pattern;
+        return matcher;
+    }
+    string body = pattern;
+    if (!body.empty() && body.front() == '^') {
+        matcher->anchorStart = true;
+        body.erase(0, 1);
+    }
+    size_t slashes = 0;
+    while (body.size() >= slashes + 2 && body[body.size() - slashes - 2] == '\\') {
+        slashes++;
+    }
+    if (!body.empty() && body.back() == '$' && slashes % 2 == 0) {
+        matcher->anchorEnd = true;
+        body.pop_back();
+    }
+    PatternParser parser(body);
+    Fragment frag;
+    if (!parser.Parse(frag) || ((matcher->anchorStart || matcher->anchorEnd) && parser.hasAlternation)) {
+        return nullptr;
+    }
+    vector<NfaState> &states = parser.states;
+    int matchState = static_cast<int>(states.size());
+    states.emplace_back();
+    states[frag.end].eps.push_back(matchState);
+
+    /* bytes no state tells apart share a class, the table gets a column per class */
+    map<vector<bool>, uint8_t> signatures;
+    uint8_t sample[256] = {0};
+    for (uint32_t b = 0; b < 256; b++) {
+        vector<bool> signature;
+        for (auto &state : states) {
+            if (state.hasChars) {
+                signature.push_back(state.chars.test(b));
+            }
+        }
+        auto it = signatures.find(signature);
+        if (it == signatures.end()) {
+            it = signatures.emplace(signature, static_cast<uint8_t>(signatures.size())).first;
+            sample[it->second] = static_cast<uint8_t>(b);
+        }
+        matcher->classOf[b] = it->second;
+    }
+    matcher->classes = signatures.size();
+
+    /* subset construction, unless anchored every step may also start a new match */
+    vector<uint32_t> seen(states.size(), 0);
+    uint32_t stamp = 1;
+    vector<int> startSet = {frag.start};
+    Closure(states, startSet, seen, stamp++);
+    sort(startSet.begin(), startSet.end());
+    map<vector<int>, uint16_t> ids;
+    vector<vector<int>> sets;
+    ids.emplace(startSet, 0);
+    sets.push_back(startSet);
+    for (size_t id = 0; id < sets.size(); id++) {
+        matcher->accepting.push_back(binary_search(sets[id].begin(), sets[id].end(), matchState));
+        if (sets[id].empty()) {
+            matcher->deadState = static_cast<int32_t>(id);
+        }
+        for (uint32_t c = 0; c < matcher->classes; c++) {
+            vector<int> moved;
+            for (int s : sets[id]) {
+                if (states[s].hasChars && states[s].chars.test(sample[c])) {
+                    moved.push_back(states[s].target);
+                }
+            }
+            Closure(states, moved, seen, stamp++);
+            if (!matcher->anchorStart) {
+                moved.insert(moved.end(), startSet.begin(), startSet.end());
+            }
+            sort(moved.begin(), moved.end());
+            moved.erase(unique(moved.begin(), moved.end()), moved.end());
+            auto it = ids.find(moved);
+            if (it == ids.end()) {
+                if (sets.size() >= MAX_MATCHER_DFA_STATES) {
+                    return nullptr;
+                }
+                it = ids.emplace(moved, static_cast<uint16_t>(sets.size())).first;
+                sets.push_back(moved);
+            }
+            matcher->next.push_back(it->second);
+        }
+    }
+    return matcher;
+}
+
+bool LogMatcher::Match(const char *text, size_t len) const
+{
+    return isLiteral ? FindLiteral(text, len) : RunDfa(text, len);
+}
+
+/*
+ * Compares the first and the last byte of the literal at 16 places at once and only looks at the
+ * rest where both agree, rare enough in log text for the whole search to run at vector speed.
+ */
+bool LogMatcher::FindLiteral(const char *text, size_t len) const
+{
+    size_t litLen = literal.size();
+    if (litLen == 0) {
+        return true;
+    }
+    if (litLen > len) {
+        return false;
+    }
+    const char *lit = literal.data();
+    size_t pos = 0;
+#if defined(__SSE2__)
+    const __m128i first = _mm_set1_epi8(lit[0]);
+    const __m128i last = _mm_set1_epi8(lit[litLen - 1]);
+    for (; pos + litLen - 1 + sizeof(__m128i) <= len; pos += sizeof(__m128i)) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + pos));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + pos + litLen - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast))));
+        while (mask != 0) {
+            uint32_t bit = static_cast<uint32_t>(__builtin_ctz(mask));
+            if (memcmp(text + pos + bit + 1, lit + 1, litLen - 1) == 0) {
+                return true;
+            }
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t first = vdupq_n_u8(static_cast<uint8_t>(lit[0]));
+    const uint8x16_t last = vdupq_n_u8(static_cast<uint8_t>(lit[litLen - 1]));
+    for (; pos + litLen - 1 + sizeof(uint8x16_t) <= len; pos += sizeof(uint8x16_t)) {
+        uint8x16_t blockFirst = vld1q_u8(reinterpret_cast<const uint8_t *>(text + pos));
+        uint8x16_t blockLast = vld1q_u8(reinterpret_cast<const uint8_t *>(text + pos + litLen - 1));
+        uint8x16_t eq = vandq_u8(vceqq_u8(first, blockFirst), vceqq_u8(last, blockLast));
+        /* four bits for every byte of the block */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (mask != 0) {
+            uint32_t bit = static_cast<uint32_t>(__builtin_ctzll(mask)) / 4;
+            if (memcmp(text + pos + bit + 1, lit + 1, litLen - 1) == 0) {
+                return true;
+            }
+            mask &= ~(0xFULL << (bit * 4));
+        }
+    }
+#endif
+    for (; pos + litLen <= len; pos++) {
+        if (text[pos] == lit[0] && memcmp(text + pos + 1, lit + 1, litLen - 1) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LogMatcher::RunDfa(const char *text, size_t len) const
+{
+    uint32_t state = 0;
+    if (!anchorEnd && accepting[state]) {
+        return true;
+    }
+    for (size_t i = 0; i < len; i++) {
+        state = next[state * classes + classOf[static_cast<uint8_t>(text[i])]];
+        if (!anchorEnd && accepting[state]) {
+            return true;
+        }
+        if (static_cast<int32_t>(state) == deadState) {
+            return false;
+        }
+    }
+    return accepting[state];
+}
+} // namespace HiviewDFX
+} // namespace OHOS
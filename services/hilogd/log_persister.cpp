@@ -27,13 +27,16 @@
 #include <sstream>
 #include <string>
 #include <thread>
+#include <algorithm>
 #include <climits>
 #include <cstdlib>
 #include <securec.h>
 #include "hilog_common.h"
 #include "log_buffer.h"
 #include "log_compress.h"
+#include "log_persister_fanout.h"
 #include "format.h"
+#include "persist_format.h"
 
 namespace OHOS {
 namespace HiviewDFX {
@@ -49,18 +52,30 @@ static std::mutex g_listMutex;
         (x) = nullptr; \
     } while (0)
 
-LogPersister::LogPersister(uint32_t id, string path, uint32_t fileSize, uint16_t compressAlg, int sleepTime,
-                           LogPersisterRotator& rotator, HilogBuffer &_buffer)
-    : id(id), path(path), fileSize(fileSize), compressAlg(compressAlg),
+LogPersister::LogPersister(uint32_t id, string path, uint32_t fileSize, uint16_t compressAlg, uint16_t fileFormat,
+                           int sleepTime, LogPersisterRotator& rotator, HilogBuffer &_buffer)
+    : id(id), path(path), fileSize(fileSize), compressAlg(compressAlg), fileFormat(fileFormat),
       sleepTime(sleepTime), rotator(&rotator)
 {
-    toExit = false;
-    hasExited = false;
-    hilogBuffer = &_buffer;
+    /* shared by every reader, so only store it once: the fanout thread reads it */
+    if (hilogBuffer != &_buffer) {
+        hilogBuffer = &_buffer;
+    }
     compressor = nullptr;
     buffer = nullptr;
     compressBuffer = nullptr;
     plainLogSize = 0;
+    stage = nullptr;
+    plainBuffer = nullptr;
+    queued = 0;
+    refused = false;
+    partSeq = 0;
+    writerExit = false;
+    stallCount = 0;
+    stallUs = 0;
+    fileStarted = false;
+    lastTime = 0;
+    tagCount = 0;
 }
 
 LogPersister::~LogPersister()
@@ -68,14 +83,18 @@ LogPersister::~LogPersister()
     SAFE_DELETE(rotator);
     SAFE_DELETE(compressor);
     SAFE_DELETE(compressBuffer);
+    SAFE_DELETE(plainBuffer);
 }
 
 int LogPersister::InitCompress()
 {
-    compressBuffer = new LogPersisterBuffer;
-    if (compressBuffer == NULL) {
+    compressBuffer = new LogCompressBuffer;
+    plainBuffer = new LogPersisterBuffer;
+    if (compressBuffer == NULL || plainBuffer == NULL) {
         return RET_FAIL;
     }
+    compressBuffer->offset = 0;
+    plainBuffer->offset = 0;
     switch (compressAlg) {
         case COMPRESS_TYPE_NONE:
             compressor = new NoneCompress();
@@ -133,36 +152,61 @@ int LogPersister::Init()
         return ERR_LOG_PERSIST_FILE_OPEN_FAIL;
     }
 
+    /* a file left by the single buffer layout grows zero filled, i.e. with empty extra slots */
+    ftruncate(fileno(fd), sizeof(LogPersisterStage));
     if (!restore) {
-        ftruncate(fileno(fd), sizeof(LogPersisterBuffer));
         fflush(fd);
         fsync(fileno(fd));
     }
-    buffer = (LogPersisterBuffer *)mmap(nullptr, sizeof(LogPersisterBuffer), PROT_READ | PROT_WRITE,
-                                        MAP_SHARED, fileno(fd), 0);
+    stage = (LogPersisterStage *)mmap(nullptr, sizeof(LogPersisterStage), PROT_READ | PROT_WRITE,
+                                      MAP_SHARED, fileno(fd), 0);
     fclose(fd);
-    if (buffer == MAP_FAILED) {
+    if (stage == MAP_FAILED) {
 #ifdef DEBUG
         cout << "mmap file failed: " << strerror(errno) << endl;
 #endif
         return RET_FAIL;
     }
     if (restore == true) {
+        /* write out whatever the previous run left queued or half filled, oldest slot first, checking
+         * every record as the last ones may not have fully reached the file before a crash
+         */
+        uint32_t head = stage->head % PERSISTER_BUFFER_SLOTS;
+        for (uint32_t i = 0; i < PERSISTER_BUFFER_SLOTS; i++) {
+            uint32_t slot = (head + i) % PERSISTER_BUFFER_SLOTS;
+            LogPersisterBuffer *pending = &stage->slots[slot];
+            if (stage->summaries[slot].records == 0) {
+                /* staged by a version without the index, let it match any query */
+                PersistIndexSetUnknown(stage->summaries[slot]);
+            }
 #ifdef DEBUG
-        cout << "Recovered persister, Offset=" << buffer->offset << endl;
+            cout << "Recovered persister, Offset=" << pending->offset << endl;
 #endif
-        WriteFile();
+            WriteFile(pending, true);
+        }
+        if (stage->lineOffset != 0) {
+            cout << "Recovered persister, last record cut at line offset " << stage->lineOffset << endl;
+        }
     } else {
-        SetBufferOffset(0);
+        for (uint32_t i = 0; i < PERSISTER_BUFFER_SLOTS; i++) {
+            stage->slots[i].offset = 0;
+        }
+    }
+    for (uint32_t i = 0; i < PERSISTER_BUFFER_SLOTS; i++) {
+        PersistIndexReset(stage->summaries[i]);
+        stage->generations[i]++;
     }
+    stage->layout = PERSISTER_STAGE_FRAMED;
+    stage->head = 0;
+    stage->lineOffset = 0;
+    buffer = &stage->slots[0];
     logPersisters.push_back(std::static_pointer_cast<LogPersister>(shared_from_this()));
     return 0;
 }
 
+/* records come through LogPersisterFanout, which is the reader the buffer notifies */
 void LogPersister::NotifyForNewData()
 {
-    condVariable.notify_one();
-    isNotified = true;
 }
 
 int LogPersister::MkDirPath(const char *pMkdir)
@@ -178,9 +222,9 @@ void LogPersister::SetBufferOffset(int off)
     buffer->offset = off;
 }
 
-int GenPersistLogHeader(HilogData *data, list<string>& persistList)
+/* the text header of every line of data, returns its length */
+int LogPersister::FormatHeader(const HilogData *data, char *header, int headerLen)
 {
-    char buffer[MAX_LOG_LEN * 2];
     HilogShowFormatBuffer showBuffer;
     showBuffer.level = data->level;
     showBuffer.pid = data->pid;
@@ -188,138 +232,364 @@ int GenPersistLogHeader(HilogData *data, list<string>& persistList)
     showBuffer.domain = data->domain;
     showBuffer.tv_sec = data->tv_sec;
     showBuffer.tv_nsec = data->tv_nsec;
+    showBuffer.data = data->tag;
+    showBuffer.tag_len = data->tag_len;
+    return HilogShowHeader(header, headerLen, showBuffer, OFF_SHOWFORMAT);
+}
 
-    int offset = data->tag_len;
-    char *dataCopy = (char*)calloc(data->len, sizeof(char));
-    if (dataCopy == nullptr) {
-        return 0;
+/* seal the frame at the slot offset, whose length bytes of payload are in place, and move past it */
+void LogPersister::CommitFrame(uint32_t length)
+{
+    char *dest = buffer->content + buffer->offset;
+    LogPersisterFrame frame;
+    frame.length = length;
+    frame.crc = PersistCrc32c(stage->generations[buffer - stage->slots], (char *)&frame.length,
+        sizeof(frame.length));
+    frame.crc = PersistCrc32c(frame.crc, dest + sizeof(frame), length);
+    (void)memcpy_s(dest, sizeof(frame), &frame, sizeof(frame));
+    SetBufferOffset(buffer->offset + sizeof(frame) + length);
+}
+
+/* copy the lines of data, starting at byte stage->lineOffset of its content, each after header into one
+ * frame of the current slot. Returns false when the slot is full, the lines copied so far are committed
+ * and stage->lineOffset tells where the record has to be resumed in the next slot.
+ */
+bool LogPersister::writeUnCompressedBuffer(HilogData *data, const char *header, int headerLen)
+{
+    if (fileFormat == PERSIST_FORMAT_BINARY) {
+        return writeBinaryRecord(data);
     }
-    if (memcpy_s(dataCopy, data->len, data->tag, data->len)) {
-        free(dataCopy);
-        return 0;
+    if (MAX_PERSISTER_BUFFER_SIZE - buffer->offset < sizeof(LogPersisterFrame) + MAX_PERSIST_HEADER_LEN) {
+        return false;
     }
-    showBuffer.data = dataCopy;
-    char *dataBegin = dataCopy + offset;
-    char *dataPos = dataCopy + offset;
-    while (*dataPos != 0) {
-        if (*dataPos == '\n') {
-            if (dataPos != dataBegin) {
-                *dataPos = 0;
-                showBuffer.tag_len = offset;
-                showBuffer.data = dataCopy;
-                HilogShowBuffer(buffer, MAX_LOG_LEN * 2, showBuffer, OFF_SHOWFORMAT);
-                persistList.push_back(buffer);
-                offset += dataPos - dataBegin + 1;
-            } else {
-                offset++;
+    const char *content = data->content;
+    uint32_t contentLen = strnlen(content, data->len - data->tag_len);
+    char *payload = buffer->content + buffer->offset + sizeof(LogPersisterFrame);
+    uint32_t room = MAX_PERSISTER_BUFFER_SIZE - buffer->offset - sizeof(LogPersisterFrame);
+    uint32_t used = 0;
+    uint32_t pos = stage->lineOffset;
+    bool full = false;
+    stage->lineOffset = 0;
+    while (pos < contentLen) {
+        const char *lineEnd = (const char *)memchr(content + pos, '\n', contentLen - pos);
+        uint32_t lineLen = (lineEnd == nullptr) ? (contentLen - pos) : (lineEnd - (content + pos));
+        if (lineLen > 0) {
+            if (room - used < lineLen + MAX_PERSIST_HEADER_LEN) {
+                stage->lineOffset = pos;
+                full = true;
+                break;
+            }
+            char *dest = payload + used;
+            (void)memcpy_s(dest, room - used, header, headerLen);
+            dest[headerLen] = ' ';
+            if (memcpy_s(dest + headerLen + 1, room - used - headerLen - 1, content + pos, lineLen) != 0) {
+                break;
             }
-            dataBegin = dataPos + 1;
+            dest[headerLen + 1 + lineLen] = '\n';
+            used += headerLen + lineLen + 2;
         }
-        dataPos++;
+        pos += lineLen + 1;
     }
-    if (dataPos != dataBegin) {
-        showBuffer.tag_len = offset;
-        showBuffer.data = dataCopy;
-        HilogShowBuffer(buffer, MAX_LOG_LEN * 2, showBuffer, OFF_SHOWFORMAT);
-        persistList.push_back(buffer);
+    if (used > 0) {
+        CommitFrame(used);
     }
-    free(dataCopy);
-    return persistList.size();
+    return !full;
 }
 
-bool LogPersister::writeUnCompressedBuffer(HilogData *data)
+/* returns the table reference of tag, 0 if it has to be written inline; a new tag is interned
+ * while the table has room, exactly as the decoder will do when it meets the inline copy
+ */
+uint32_t LogPersister::InternTag(const char *tag, uint32_t tagLen)
 {
-    int listSize = persistList.size();
+    if (tagLen >= MAX_TAG_LEN) {
+        return 0;
+    }
+    uint32_t hash = 0x811C9DC5;
+    for (uint32_t i = 0; i < tagLen; i++) {
+        hash = (hash ^ static_cast<uint8_t>(tag[i])) * 0x01000193;
+    }
+    uint32_t slotNum = sizeof(tagSlots) / sizeof(tagSlots[0]);
+    for (uint32_t i = 0; i < slotNum; i++) {
+        uint16_t &slot = tagSlots[(hash + i) % slotNum];
+        if (slot == 0) {
+            if (tagCount < PERSIST_MAX_TAGS &&
+                memcpy_s(tagNames[tagCount], MAX_TAG_LEN, tag, tagLen) == 0) {
+                tagNames[tagCount][tagLen] = '\0';
+                slot = ++tagCount;
+            }
+            return 0;
+        }
+        if (strncmp(tagNames[slot - 1], tag, MAX_TAG_LEN) == 0) {
+            return slot;
+        }
+    }
+    return 0;
+}
 
-    if (persistList.empty()) {
-        listSize = GenPersistLogHeader(data, persistList);
+/* encode data as one record of the binary format, see persist_format.h */
+bool LogPersister::writeBinaryRecord(HilogData *data)
+{
+    if (MAX_PERSISTER_BUFFER_SIZE - buffer->offset < sizeof(LogPersisterFrame) + MAX_PERSIST_RECORD_LEN + 1) {
+        return false;
     }
-    while (listSize--) {
-        string header = persistList.front();
-        uint16_t headerLen = header.length();
-        uint16_t size = headerLen + 1;
-        uint32_t orig_offset = buffer->offset;
-        int r = 0;
-        if (buffer->offset + size > MAX_PERSISTER_BUFFER_SIZE)
-            return false;
-        r = memcpy_s(buffer->content + buffer->offset, MAX_PERSISTER_BUFFER_SIZE - buffer->offset,
-            header.c_str(), headerLen);
-        if (r != 0) {
-            SetBufferOffset(orig_offset);
+    char *dest = buffer->content + buffer->offset + sizeof(LogPersisterFrame);
+    uint32_t len = 0;
+    if (buffer->offset == 0) {
+        dest[len++] = PERSIST_BLOCK_START;
+        lastTime = 0;
+        tagCount = 0;
+        (void)memset_s(tagSlots, sizeof(tagSlots), 0, sizeof(tagSlots));
+    }
+    dest[len++] = static_cast<char>((data->level & 0x07) | ((data->type & 0x0F) << 3));
+    /* tag_len comes from the client, decoders refuse tags of MAX_TAG_LEN or longer */
+    uint32_t tagLen = strnlen(data->tag, min<uint32_t>(data->tag_len, MAX_TAG_LEN - 1));
+    uint32_t tagRef = InternTag(data->tag, tagLen);
+    len += PutVarint(dest + len, tagRef);
+    if (tagRef == 0) {
+        len += PutVarint(dest + len, tagLen);
+        if (memcpy_s(dest + len, MAX_TAG_LEN, data->tag, tagLen) != 0) {
             return true;
         }
-        persistList.pop_front();
-        SetBufferOffset(buffer->offset + headerLen);
-        buffer->content[buffer->offset] = '\n';
-        SetBufferOffset(buffer->offset + 1);
+        len += tagLen;
+    }
+    const uint64_t nsPerSec = 1000000000ULL;
+    uint64_t time = data->tv_sec * nsPerSec + data->tv_nsec;
+    len += PutVarint(dest + len, ZigZagEncode(static_cast<int64_t>(time - lastTime)));
+    lastTime = time;
+    len += PutVarint(dest + len, data->pid);
+    len += PutVarint(dest + len, data->tid);
+    len += PutVarint(dest + len, data->domain);
+    uint32_t contentLen = strnlen(data->content, data->len - data->tag_len);
+    len += PutVarint(dest + len, contentLen);
+    if (memcpy_s(dest + len, MAX_LOG_LEN, data->content, contentLen) != 0) {
+        return true;
     }
+    len += contentLen;
+    CommitFrame(len);
     return true;
 }
 
+void LogPersister::AddToIndex(const HilogData *data)
+{
+    const uint64_t nsPerSec = 1000000000ULL;
+    PersistIndexAdd(stage->summaries[buffer - stage->slots], data->tv_sec * nsPerSec + data->tv_nsec,
+        data->pid, data->domain, data->type, data->level);
+}
+
 int LogPersister::WriteData(HilogData *data)
 {
     if (data == nullptr)
         return -1;
-    if (writeUnCompressedBuffer(data))
+    char header[MAX_PERSIST_HEADER_LEN];
+    int headerLen = (fileFormat == PERSIST_FORMAT_TEXT) ? FormatHeader(data, header, sizeof(header)) : 0;
+    return WriteRecord(data, header, headerLen);
+}
+
+int LogPersister::WriteRecord(HilogData *data, const char *header, int headerLen)
+{
+    AddToIndex(data);
+    if (writeUnCompressedBuffer(data, header, headerLen))
         return 0;
-    if (compressor->Compress(buffer, compressBuffer) != 0) {
-        cout << "COMPRESS Error" << endl;
-        return RET_FAIL;
-    };
-    WriteFile();
-    return writeUnCompressedBuffer(data) ? 0 : -1;
+    SubmitBuffer(true);
+    AddToIndex(data);
+    if (writeUnCompressedBuffer(data, header, headerLen))
+        return 0;
+    stage->lineOffset = 0;
+    return -1;
+}
+
+/* WriteRecord without waiting for the writer, false if the job has no room for data yet and it has to be
+ * offered again, which goes on from the lines already taken
+ */
+bool LogPersister::TryWriteRecord(HilogData *data, const char *header, int headerLen)
+{
+    if (stage->lineOffset != 0 && data->seq != partSeq) {
+        /* the buffer dropped the record split over two slots before the rest of it got in */
+        stage->lineOffset = 0;
+    }
+    AddToIndex(data);
+    if (writeUnCompressedBuffer(data, header, headerLen)) {
+        return true;
+    }
+    if (!SubmitBuffer(false)) {
+        partSeq = data->seq;
+        return false;
+    }
+    AddToIndex(data);
+    if (!writeUnCompressedBuffer(data, header, headerLen)) {
+        stage->lineOffset = 0;
+    }
+    return true;
 }
 
 void LogPersister::Start()
 {
-    hilogBuffer->AddLogReader(weak_from_this());
-    auto newThread =
-        thread(&LogPersister::ThreadFunc, static_pointer_cast<LogPersister>(shared_from_this()));
-    newThread.detach();
+    writer = thread(&LogPersister::WriterThreadFunc, this);
+    LogPersisterFanout::GetInstance(*hilogBuffer).Add(static_pointer_cast<LogPersister>(shared_from_this()));
     return;
 }
 
-inline void LogPersister::WriteFile()
+/* hand a partly filled slot to the writer when no records came for a while */
+void LogPersister::Flush()
 {
-    if (buffer->offset == 0)
+    /* the writer is busy anyway if no slot is free, keep filling this one */
+    SubmitBuffer(false);
+}
+
+/* hand the filled slot over to the writer thread, blocking while every other slot is still queued */
+bool LogPersister::SubmitBuffer(bool block)
+{
+    if (buffer->offset == 0) {
+        return true;
+    }
+    unique_lock<mutex> lk(stageMutex);
+    if (queued + 1 >= PERSISTER_BUFFER_SLOTS) {
+        if (!block) {
+            refused = true;
+            return false;
+        }
+        stallCount++;
+        auto start = chrono::steady_clock::now();
+        stageFreed.wait(lk, [this] { return queued + 1 < PERSISTER_BUFFER_SLOTS; });
+        stallUs += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    }
+    queued++;
+    uint32_t slot = (stage->head + queued) % PERSISTER_BUFFER_SLOTS;
+    PersistIndexReset(stage->summaries[slot]);
+    stage->generations[slot]++;
+    buffer = &stage->slots[slot];
+    lk.unlock();
+    stageQueued.notify_one();
+    return true;
+}
+
+void LogPersister::WriteFileHeader()
+{
+    PersistFileHeader header;
+    InitPersistFileHeader(header);
+    if (compressor->Compress((char *)&header, sizeof(header), compressBuffer) != 0) {
+        cout << "COMPRESS Error" << endl;
+    } else {
+        rotator->Input((char *)compressBuffer->content, compressBuffer->offset);
+    }
+    compressBuffer->offset = 0;
+}
+
+/* gather the payloads of the frames in pending into plainBuffer, with verify stopping at the first frame
+ * that does not check out, and return their length
+ */
+uint32_t LogPersister::Unframe(LogPersisterBuffer *pending, bool verify)
+{
+    uint32_t generation = stage->generations[pending - stage->slots];
+    uint32_t pos = 0;
+    plainBuffer->offset = 0;
+    while (pending->offset - pos >= sizeof(LogPersisterFrame)) {
+        LogPersisterFrame frame;
+        (void)memcpy_s(&frame, sizeof(frame), pending->content + pos, sizeof(frame));
+        const char *payload = pending->content + pos + sizeof(frame);
+        if (frame.length > pending->offset - pos - sizeof(frame)) {
+            break;
+        }
+        if (verify) {
+            uint32_t crc = PersistCrc32c(generation, (char *)&frame.length, sizeof(frame.length));
+            if (PersistCrc32c(crc, payload, frame.length) != frame.crc) {
+                break;
+            }
+        }
+        (void)memcpy_s(plainBuffer->content + plainBuffer->offset, MAX_PERSISTER_BUFFER_SIZE - plainBuffer->offset,
+            payload, frame.length);
+        plainBuffer->offset += frame.length;
+        pos += sizeof(frame) + frame.length;
+    }
+    if (pos != pending->offset) {
+        cout << "LogPersister " << id << " dropped " << (pending->offset - pos) << " bytes of torn records" << endl;
+    }
+    return plainBuffer->offset;
+}
+
+void LogPersister::WriteFile(LogPersisterBuffer *pending, bool verify)
+{
+    if (pending->offset == 0)
         return;
-    rotator->Input((char *)compressBuffer->content, compressBuffer->offset);
-    plainLogSize += buffer->offset;
-    if (plainLogSize >= fileSize) {
+    const char *content = pending->content;
+    uint32_t length = pending->offset;
+    if (stage->layout == PERSISTER_STAGE_FRAMED) {
+        content = plainBuffer->content;
+        length = Unframe(pending, verify);
+        if (length == 0) {
+            pending->offset = 0;
+            return;
+        }
+    }
+    if (fileFormat == PERSIST_FORMAT_BINARY && !fileStarted) {
+        WriteFileHeader();
+    }
+    fileStarted = true;
+    /* the stream of the file goes on, every block ends at a flush point of it */
+    PersistIndexEntry &entry = stage->summaries[pending - stage->slots];
+    if (compressor->Compress(content, length, compressBuffer) != 0) {
+        /* the stream was reset, the rest of the file could not be decoded after what is in it */
+        cout << "COMPRESS Error" << endl;
         plainLogSize = 0;
-        rotator->FinishInput();
+        FinishFile(false);
+    } else {
+        entry.plainLength = length;
+        rotator->InputBlock((char *)compressBuffer->content, compressBuffer->offset, entry);
+        plainLogSize += length;
     }
     compressBuffer->offset = 0;
-    SetBufferOffset(0);
+    pending->offset = 0;
+    if (plainLogSize >= fileSize) {
+        plainLogSize = 0;
+        FinishFile(true);
+    }
 }
 
-int LogPersister::ThreadFunc()
+/* end the stream of the file unless it has been reset already, the next block starts a new file */
+void LogPersister::FinishFile(bool endStream)
 {
-    std::thread::id tid = std::this_thread::get_id();
-    cout << __func__ << " " << tid << endl;
-    while (true) {
-        if (toExit) {
-            break;
+    if (endStream && fileStarted) {
+        if (compressor->Finish(compressBuffer) != 0) {
+            cout << "COMPRESS Error" << endl;
+        } else if (compressBuffer->offset > 0) {
+            rotator->Input((char *)compressBuffer->content, compressBuffer->offset);
         }
-        if (!hilogBuffer->Query(shared_from_this())) {
-            unique_lock<mutex> lk(cvMutex);
-            if (condVariable.wait_for(lk, sleepTime * 1s) ==
-                cv_status::timeout) {
-                if (toExit) {
-                    break;
-                }
-                WriteFile();
+        compressBuffer->offset = 0;
+    }
+    rotator->FinishInput();
+    fileStarted = false;
+}
+
+void LogPersister::WriterThreadFunc()
+{
+    while (true) {
+        LogPersisterBuffer *pending = nullptr;
+        {
+            unique_lock<mutex> lk(stageMutex);
+            stageQueued.wait(lk, [this] { return queued > 0 || writerExit; });
+            if (queued == 0) {
+                break;
             }
+            pending = &stage->slots[stage->head];
+        }
+        WriteFile(pending, false);
+        bool wake = false;
+        {
+            std::lock_guard<mutex> guard(stageMutex);
+            stage->head = (stage->head + 1) % PERSISTER_BUFFER_SLOTS;
+            queued--;
+            wake = refused;
+            refused = false;
+        }
+        stageFreed.notify_one();
+        if (wake) {
+            /* the fanout left records for this job, which can take them now */
+            LogPersisterFanout::GetInstance(*hilogBuffer).NotifyForNewData();
         }
     }
-    WriteFile();
-    {
-        std::lock_guard<mutex> guard(mutexForhasExited);
-        hasExited = true;
+    if (plainLogSize > 0) {
+        FinishFile(true);
     }
-    cvhasExited.notify_all();
-    hilogBuffer->RemoveLogReader(shared_from_this());
-    return 0;
 }
 
 int LogPersister::Query(uint16_t logType, list<LogPersistQueryResult> &results)
@@ -346,7 +616,8 @@ void LogPersister::FillInfo(LogPersistQueryResult *response)
         return;
     }
     response->compressAlg = compressAlg;
-    rotator->FillInfo(&response->fileSize, &response->fileNum);
+    response->fileFormat = fileFormat;
+    rotator->FillInfo(&response->fileSize, &response->fileNum, &response->syncMode);
     return;
 }
 
@@ -369,27 +640,30 @@ int LogPersister::Kill(const uint32_t id)
     return found ? 0 : ERR_LOG_PERSIST_JOBID_FAIL;
 }
 
-bool LogPersister::isExited()
-{
-    return hasExited;
-}
-
 void LogPersister::Exit()
 {
     std::cout << "LogPersister Exit!" << std::endl;
-    toExit = true;
-    condVariable.notify_all();
-    unique_lock<mutex> lk(mutexForhasExited);
-    if (!isExited()) {
-        cvhasExited.wait(lk);
+    LogPersisterFanout::GetInstance(*hilogBuffer).Remove(static_pointer_cast<LogPersister>(shared_from_this()));
+    SubmitBuffer(true);
+    {
+        std::lock_guard<mutex> guard(stageMutex);
+        writerExit = true;
+    }
+    stageQueued.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    if (stallCount > 0) {
+        cout << "LogPersister " << id << " stalled " << stallCount << " times, " << stallUs << "us in total" << endl;
     }
     delete rotator;
     this->rotator = nullptr;
-    munmap(buffer, MAX_PERSISTER_BUFFER_SIZE);
+    munmap(stage, sizeof(LogPersisterStage));
     cout << "removed mmap file" << endl;
     remove(mmapPath.c_str());
     return;
 }
+
 bool LogPersister::Identify(uint32_t id)
 {
     return this->id == id;
@@ -404,5 +678,15 @@ uint8_t LogPersister::GetType() const
 {
     return TYPE_PERSISTER;
 }
+
+uint16_t LogPersister::GetFileFormat() const
+{
+    return fileFormat;
+}
+
+int LogPersister::GetSleepTime() const
+{
+    return sleepTime;
+}
 } // namespace HiviewDFX
 } // namespace OHOS
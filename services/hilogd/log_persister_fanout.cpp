@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "log_persister_fanout.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "persist_format.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+using namespace std;
+
+static bool JobTakes(const LogPersister &job, const HilogData *data)
+{
+    return ((1 << data->type) & job.queryCondition.types) != 0 &&
+        ((1 << data->level) & job.queryCondition.levels) != 0;
+}
+
+static int FormatFor(const LogPersister &job, const HilogData *data, char *header, int headerLen)
+{
+    return (job.GetFileFormat() == PERSIST_FORMAT_TEXT) ? LogPersister::FormatHeader(data, header, headerLen) : 0;
+}
+
+/* walks the buffer for one job the fanout does not feed, it stops at every record and leaves the filtering
+ * to the job
+ */
+class LogPersisterCursor : public LogReader {
+public:
+    explicit LogPersisterCursor(shared_ptr<LogPersister> job) : job(job)
+    {
+        queryCondition.types = UINT16_MAX;
+        queryCondition.levels = UINT16_MAX;
+    }
+    void NotifyForNewData()
+    {
+        isNotified = true;
+    }
+    int WriteData(HilogData *data)
+    {
+        if (data != nullptr && JobTakes(*job, data)) {
+            char header[MAX_PERSIST_HEADER_LEN];
+            int headerLen = FormatFor(*job, data, header, sizeof(header));
+            refused = !job->TryWriteRecord(data, header, headerLen);
+        }
+        return 0;
+    }
+    uint8_t GetType() const
+    {
+        return TYPE_PERSISTER;
+    }
+    shared_ptr<LogPersister> job;
+    bool refused = false; /* the job could not take the last record yet */
+    uint32_t steps = 0;
+};
+
+LogPersisterFanout& LogPersisterFanout::GetInstance(HilogBuffer &buffer)
+{
+    static shared_ptr<LogPersisterFanout> fanout(new LogPersisterFanout(buffer));
+    return *fanout;
+}
+
+LogPersisterFanout::LogPersisterFanout(HilogBuffer &buffer)
+{
+    hilogBuffer = &buffer;
+}
+
+void LogPersisterFanout::Add(shared_ptr<LogPersister> job)
+{
+    {
+        std::lock_guard<mutex> guard(jobMutex);
+        joining.push_back(job);
+        jobsChanged = true;
+        if (!started) {
+            started = true;
+            hilogBuffer->AddLogReader(weak_from_this());
+            thread(&LogPersisterFanout::ThreadFunc, this).detach();
+        }
+    }
+    std::lock_guard<mutex> guard(cvMutex);
+    condVariable.notify_one();
+}
+
+void LogPersisterFanout::Remove(shared_ptr<LogPersister> job)
+{
+    list<shared_ptr<LogPersisterCursor>> dropped;
+    {
+        std::lock_guard<mutex> guard(jobMutex);
+        jobs.remove(job);
+        joining.remove(job);
+        for (auto it = catching.begin(); it != catching.end();) {
+            if ((*it)->job == job) {
+                dropped.push_back(*it);
+                it = catching.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        jobsChanged = true;
+    }
+    /* the round going on may still hand it a record, rounds are short as nothing in them waits */
+    std::lock_guard<mutex> pass(passMutex);
+    for (auto &cursor : dropped) {
+        hilogBuffer->RemoveLogReader(cursor);
+    }
+}
+
+void LogPersisterFanout::NotifyForNewData()
+{
+    std::lock_guard<mutex> guard(cvMutex);
+    isNotified = true;
+    condVariable.notify_one();
+}
+
+/* called with jobMutex held, by the fanout thread only, so queryCondition never changes under a Query */
+void LogPersisterFanout::UpdateJobs()
+{
+    if (jobs.empty() && !joining.empty()) {
+        /* nobody to catch up with, start over from the oldest record like a reader of its own */
+        jobs.splice(jobs.end(), joining);
+        SetReload(true);
+    }
+    for (auto &job : joining) {
+        /* from the oldest record on, the cursor starts there on its first Query */
+        auto cursor = make_shared<LogPersisterCursor>(job);
+        hilogBuffer->AddLogReader(cursor);
+        catching.push_back(cursor);
+    }
+    joining.clear();
+    uint16_t types = 0;
+    uint16_t levels = 0;
+    sleepTime = 0;
+    for (auto &job : jobs) {
+        types |= job->queryCondition.types;
+        levels |= job->queryCondition.levels;
+        sleepTime = (sleepTime == 0) ? job->GetSleepTime() : min(sleepTime, job->GetSleepTime());
+    }
+    for (auto &cursor : catching) {
+        int jobSleep = cursor->job->GetSleepTime();
+        sleepTime = (sleepTime == 0) ? jobSleep : min(sleepTime, jobSleep);
+    }
+    /* eviction matches the records it drops against the filter of the fanout as well */
+    hilogBuffer->GetBufferLock();
+    queryCondition.types = types;
+    queryCondition.levels = levels;
+    hilogBuffer->ReleaseBufferLock();
+    jobsChanged = false;
+}
+
+/*
+ * Called after a Query that job could not take the record of, which is still the last one of the
+ * fanout unless the buffer dropped it since. The job goes on from that record with a cursor of its own.
+ */
+void LogPersisterFanout::Park(shared_ptr<LogPersister> job)
+{
+    auto cursor = make_shared<LogPersisterCursor>(job);
+    cursor->SetReload(false);
+    hilogBuffer->AddLogReader(cursor);
+    hilogBuffer->GetBufferLock();
+    bool dropped = (lastPos == readPos);
+    cursor->readPos = lastPos;
+    cursor->lastPos = lastPos;
+    hilogBuffer->ReleaseBufferLock();
+    std::lock_guard<mutex> guard(jobMutex);
+    if (dropped || find(jobs.begin(), jobs.end(), job) == jobs.end()) {
+        /* the record is gone, nothing to catch up with, or the job was removed meanwhile */
+        hilogBuffer->RemoveLogReader(cursor);
+        return;
+    }
+    jobs.remove(job);
+    catching.push_back(cursor);
+    jobsChanged = true;
+}
+
+/* the job of cursor has what the fanout handed the others, it is fed along with them from now on */
+void LogPersisterFanout::Rejoin(shared_ptr<LogPersisterCursor> cursor)
+{
+    hilogBuffer->RemoveLogReader(cursor);
+    std::lock_guard<mutex> guard(jobMutex);
+    auto it = find(catching.begin(), catching.end(), cursor);
+    if (it == catching.end()) {
+        return;
+    }
+    catching.erase(it);
+    jobs.push_back(cursor->job);
+    jobsChanged = true;
+    cout << "LogPersisterFanout: job " << cursor->job->getPath() << " caught up " << cursor->steps << " records"
+        << endl;
+}
+
+/*
+ * Hands the job of cursor up to PERSIST_CATCHUP_BATCH records, so a long catch up does not hold back the
+ * jobs the fanout feeds, and gives it back to the fanout once the cursor and the fanout stand at the same
+ * record. Both positions move together when old records are dropped, the buffer lock keeps them still
+ * while they are compared. Returns false if it got nowhere.
+ */
+bool LogPersisterFanout::CatchUp(shared_ptr<LogPersisterCursor> cursor)
+{
+    for (uint32_t i = 0; i < PERSIST_CATCHUP_BATCH; i++) {
+        bool read = hilogBuffer->Query(cursor);
+        if (cursor->refused) {
+            /* offered again once the writer of the job made room */
+            hilogBuffer->GetBufferLock();
+            cursor->readPos = cursor->lastPos;
+            hilogBuffer->ReleaseBufferLock();
+            cursor->refused = false;
+            return i > 0;
+        }
+        cursor->steps += read ? 1 : 0;
+        hilogBuffer->GetBufferLock();
+        bool level = (cursor->readPos == readPos && cursor->lastPos == lastPos);
+        hilogBuffer->ReleaseBufferLock();
+        if (level) {
+            Rejoin(cursor);
+            return true;
+        }
+        if (!read) {
+            return i > 0;
+        }
+    }
+    return true;
+}
+
+void LogPersisterFanout::Dispatch(HilogData *data)
+{
+    char header[MAX_PERSIST_HEADER_LEN];
+    int headerLen = -1;
+    for (auto &job : active) {
+        if (!JobTakes(*job, data)) {
+            continue;
+        }
+        if (headerLen < 0 && job->GetFileFormat() == PERSIST_FORMAT_TEXT) {
+            headerLen = FormatFor(*job, data, header, sizeof(header));
+        }
+        if (!job->TryWriteRecord(data, header, (headerLen < 0) ? 0 : headerLen)) {
+            /* its writer is behind, the other jobs do not wait for it */
+            stalled.push_back(job);
+        }
+    }
+}
+
+/* called by HilogBuffer::Query from ThreadFunc, under the shared buffer lock */
+int LogPersisterFanout::WriteData(HilogData *data)
+{
+    if (data != nullptr) {
+        Dispatch(data);
+    }
+    return 0;
+}
+
+void LogPersisterFanout::ThreadFunc()
+{
+    shared_ptr<LogReader> self = shared_from_this();
+    while (true) {
+        bool busy = false;
+        {
+            std::lock_guard<mutex> pass(passMutex);
+            list<shared_ptr<LogPersisterCursor>> cursors;
+            {
+                std::lock_guard<mutex> guard(jobMutex);
+                if (jobsChanged) {
+                    UpdateJobs();
+                }
+                active = jobs;
+                cursors = catching;
+            }
+            busy = hilogBuffer->Query(self);
+            for (auto &job : stalled) {
+                Park(job);
+            }
+            stalled.clear();
+            for (auto &cursor : cursors) {
+                busy = CatchUp(cursor) || busy;
+            }
+        }
+        if (busy) {
+            continue;
+        }
+        unique_lock<mutex> lk(cvMutex);
+        int wait = (sleepTime > 0) ? sleepTime : 1;
+        if (!condVariable.wait_for(lk, chrono::seconds(wait), [this] { return isNotified || jobsChanged; })) {
+            lk.unlock();
+            std::lock_guard<mutex> pass(passMutex);
+            list<shared_ptr<LogPersister>> idle;
+            {
+                std::lock_guard<mutex> guard(jobMutex);
+                idle = jobs;
+                for (auto &cursor : catching) {
+                    idle.push_back(cursor->job);
+                }
+            }
+            for (auto &job : idle) {
+                job->Flush();
+            }
+        }
+    }
+}
+
+uint8_t LogPersisterFanout::GetType() const
+{
+    return TYPE_PERSISTER;
+}
+} // namespace HiviewDFX
+} // namespace OHOS
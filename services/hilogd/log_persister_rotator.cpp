@@ -13,13 +13,15 @@
  * limitations under the License.
  */
 #include "log_persister_rotator.h"
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <iostream>
 #include <sstream>
-#include <fstream>
 #include <cstdio>
+#include <cstring>
 #include <securec.h>
+#include <vector>
 
 namespace OHOS {
 namespace HiviewDFX {
@@ -27,12 +29,12 @@ using namespace std;
 
 constexpr uint64_t PRIME = 0x100000001B3ull;
 constexpr uint64_t BASIS = 0xCBF29CE484222325ull;
-uint64_t GetInfoHash(const PersistRecoveryInfo &info)
+uint64_t GetInfoHash(const PersistRecoveryInfo &info, size_t len)
 {
     uint64_t ret {BASIS};
     const char *p = (char *)&info;
     unsigned long i = 0;
-    while (i < sizeof(PersistRecoveryInfo)) {
+    while (i < len && i < sizeof(PersistRecoveryInfo)) {
         ret ^= *(p + i);
         ret *= PRIME;
         i++;
@@ -40,16 +42,23 @@ uint64_t GetInfoHash(const PersistRecoveryInfo &info)
     return ret;
 }
 
-LogPersisterRotator::LogPersisterRotator(string path, uint32_t fileSize, uint32_t fileNum, string suffix)
-    : fileNum(fileNum), fileSize(fileSize), fileName(path), fileSuffix(suffix)
+LogPersisterRotator::LogPersisterRotator(string path, uint32_t fileSize, uint32_t fileNum, string suffix,
+    uint16_t syncMode)
+    : fileNum(fileNum), fileSize(fileSize), fileName(path), fileSuffix(suffix), syncMode(syncMode),
+    ioEngine(LogIoEngine::GetInstance())
 {
     index = -1;
     needRotate = true;
+    if (this->fileNum == 0) {
+        this->fileNum = 1;
+    }
     memset_s(&info, sizeof(info), 0, sizeof(info));
 }
 
 LogPersisterRotator::~LogPersisterRotator()
 {
+    CloseOutput();
+    free(directBuf);
     if (fdinfo != nullptr) {
         fclose(fdinfo);
     }
@@ -60,6 +69,52 @@ int LogPersisterRotator::Init()
 {
     OpenInfoFile();
     if (fdinfo == nullptr) return RET_FAIL;
+    if (restore) {
+        /* continue after the newest file so the manifest order holds */
+        vector<PersistManifestEntry> files;
+        if (ReadPersistManifest(fileName + PERSIST_MANIFEST_SUFFIX, files) == RET_SUCCESS && !files.empty()) {
+            index = static_cast<int>(files.back().seq);
+        } else {
+            AdoptUnlistedFiles();
+        }
+    }
+    return RET_SUCCESS;
+}
+
+/*
+ * A job saved by a hilogd without manifests kept "<path>.0" oldest and shifted the others down on
+ * rotation. Its files "<path>.0" on are taken as sequence 0 on, which puts each in its own slot,
+ * and listed in a manifest.
+ */
+void LogPersisterRotator::AdoptUnlistedFiles()
+{
+    uint32_t count = 0;
+    struct stat st;
+    while (count < fileNum && stat(SlotName(count).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        count++;
+    }
+    if (count == 0) {
+        return;
+    }
+    index = static_cast<int>(count) - 1;
+    cout << "Adopted " << count << " persister files of " << fileName << endl;
+    WriteManifest();
+}
+
+static int PwriteAll(int fd, const char *buf, size_t length, uint64_t offset)
+{
+    while (length > 0) {
+        ssize_t ret = pwrite(fd, buf, length, offset);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return RET_FAIL;
+        }
+        buf += ret;
+        length -= static_cast<size_t>(ret);
+        offset += static_cast<uint64_t>(ret);
+    }
     return RET_SUCCESS;
 }
 
@@ -68,56 +123,284 @@ int LogPersisterRotator::Input(const char *buf, uint32_t length)
     cout << __func__ << " " << fileName << " " << index
         << " " << length  << " need: " << needRotate << endl;
     if (length <= 0 || buf == nullptr) return ERR_LOG_PERSIST_COMPRESS_BUFFER_EXP;
+    PrepareOutput();
+    if (output < 0) return RET_FAIL;
+    return WriteOutput(buf, length);
+}
+
+int LogPersisterRotator::WriteOutput(const char *buf, uint32_t length)
+{
+    if (directOutput >= 0 && length >= PERSIST_DIRECT_MIN_LEN && WriteDirect(buf, length) == RET_SUCCESS) {
+        fileOffset += length;
+        return RET_SUCCESS;
+    }
+    if (PwriteAll(output, buf, length, fileOffset) != RET_SUCCESS) {
+        cout << "Failed to write persister file " << fileName << " " << strerror(errno) << endl;
+        return RET_FAIL;
+    }
+    if (directBuf != nullptr) {
+        /* keep the partial last page for the next direct write, which has to rewrite it */
+        uint32_t page = fileOffset % PERSIST_IO_ALIGN;
+        uint64_t end = fileOffset + length;
+        uint32_t endPage = end % PERSIST_IO_ALIGN;
+        if (end - fileOffset + page >= PERSIST_IO_ALIGN) {
+            (void)memcpy_s(directBuf, directBufLen, buf + length - endPage, endPage);
+        } else {
+            (void)memcpy_s(directBuf + page, directBufLen - page, buf, length);
+        }
+    }
+    fileOffset += length;
+    return RET_SUCCESS;
+}
+
+/*
+ * Write the whole pages from the partial last page of the file on through the O_DIRECT fd,
+ * and the partial page left at the end through the buffered fd, so the file is complete after
+ * every write. Only the rewrite of one partial page is on top of what buffered writes cost.
+ */
+int LogPersisterRotator::WriteDirect(const char *buf, uint32_t length)
+{
+    uint32_t head = fileOffset % PERSIST_IO_ALIGN;
+    uint32_t total = head + length;
+    uint32_t need = (total + PERSIST_IO_ALIGN - 1) / PERSIST_IO_ALIGN * PERSIST_IO_ALIGN;
+    if (need > directBufLen) {
+        void *bigger = nullptr;
+        if (posix_memalign(&bigger, PERSIST_IO_ALIGN, need) != 0) {
+            return RET_FAIL;
+        }
+        (void)memcpy_s(bigger, need, directBuf, head);
+        free(directBuf);
+        directBuf = static_cast<char *>(bigger);
+        directBufLen = need;
+    }
+    (void)memcpy_s(directBuf + head, directBufLen - head, buf, length);
+    uint32_t aligned = total / PERSIST_IO_ALIGN * PERSIST_IO_ALIGN;
+    uint64_t start = fileOffset - head;
+    if (PwriteAll(directOutput, directBuf, aligned, start) != RET_SUCCESS) {
+        cout << "Direct write failed, " << strerror(errno) << ", falling back to buffered writes" << endl;
+        close(directOutput);
+        directOutput = -1;
+        return RET_FAIL;
+    }
+    uint32_t tail = total - aligned;
+    if (tail > 0 && PwriteAll(output, directBuf + aligned, tail, start + aligned) != RET_SUCCESS) {
+        return RET_FAIL;
+    }
+    (void)memmove_s(directBuf, directBufLen, directBuf + aligned, tail);
+    return RET_SUCCESS;
+}
+
+/*
+ * The syncs of the file and its index go to the kernel in one call. Only PERSIST_SYNC_ALWAYS and
+ * a forced sync wait for them, otherwise the job goes on and the cache of what they made durable
+ * is dropped by a later call. Returns false if the engine failed, to sync on our own.
+ */
+bool LogPersisterRotator::SyncAsync(int fd, bool force)
+{
+    if (ioEngine.Sync(fd, fileOffset, ioTracker) != RET_SUCCESS) {
+        return false;
+    }
+    if (indexOutput >= 0) {
+        (void)ioEngine.Sync(indexOutput, 0, ioTracker);
+    }
+    ioEngine.Submit();
+    syncedOffset = fileOffset;
+    if ((syncMode == PERSIST_SYNC_ALWAYS || force) && ioEngine.Wait(ioTracker) != 0) {
+        cout << "Failed to sync persister file " << fileName << endl;
+    }
+    uint64_t synced = ioTracker.Synced();
+    if (synced > cachedOffset) {
+        (void)posix_fadvise(fd, cachedOffset, synced - cachedOffset, POSIX_FADV_DONTNEED);
+        cachedOffset = synced;
+    }
+    return true;
+}
+
+int LogPersisterRotator::InputBlock(const char *buf, uint32_t length, PersistIndexEntry &entry)
+{
+    if (length <= 0 || buf == nullptr) return ERR_LOG_PERSIST_COMPRESS_BUFFER_EXP;
+    PrepareOutput();
+    entry.offset = fileOffset;
+    entry.length = length;
+    int ret = Input(buf, length);
+    if (ret == 0 && indexOutput >= 0) {
+        (void)PwriteAll(indexOutput, (const char *)&entry, sizeof(entry),
+            sizeof(PersistIndexHeader) + indexEntries * sizeof(entry));
+        indexEntries++;
+    }
+    SyncOutput(false);
+    return ret;
+}
+
+void LogPersisterRotator::PrepareOutput()
+{
     if (needRotate) {
-        output.close();
+        CloseOutput();
         Rotate();
         needRotate = false;
     }
-    output.write(buf, length);
-    output.flush();
-    return 0;
 }
 
-void LogPersisterRotator::InternalRotate()
+void LogPersisterRotator::OpenOutput(const string &name)
+{
+    const mode_t fileMode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+    output = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, fileMode);
+    indexOutput = open((name + PERSIST_INDEX_SUFFIX).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, fileMode);
+    if (output < 0 || indexOutput < 0) {
+        cout << "Failed to open persister file " << name << " " << strerror(errno) << endl;
+    }
+    if (output >= 0) {
+        /* reserve the file in one extent, CloseOutput gives back what was not used */
+        (void)fallocate(output, FALLOC_FL_KEEP_SIZE, 0, fileSize);
+#ifdef HILOG_PERSIST_DIRECT_IO
+        directOutput = open(name.c_str(), O_WRONLY | O_DIRECT | O_CLOEXEC);
+        if (directOutput >= 0 && directBuf == nullptr) {
+            void *buf = nullptr;
+            if (posix_memalign(&buf, PERSIST_IO_ALIGN, PERSIST_DIRECT_MIN_LEN) == 0) {
+                directBuf = static_cast<char *>(buf);
+                directBufLen = PERSIST_DIRECT_MIN_LEN;
+            }
+        }
+        if (directOutput >= 0 && directBuf == nullptr) {
+            close(directOutput);
+            directOutput = -1;
+        }
+#endif
+    }
+    if (indexOutput >= 0) {
+        PersistIndexHeader header;
+        InitPersistIndexHeader(header);
+        (void)PwriteAll(indexOutput, (const char *)&header, sizeof(header), 0);
+    }
+    indexEntries = 0;
+    fileOffset = 0;
+    syncedOffset = 0;
+    cachedOffset = 0;
+    lastSync = chrono::steady_clock::now();
+}
+
+void LogPersisterRotator::CloseOutput()
+{
+    if (output >= 0) {
+        /* a finished file is complete on storage in the sync modes */
+        SyncOutput(syncMode != PERSIST_SYNC_NONE);
+        if (ioEngine.Wait(ioTracker) != 0) {
+            cout << "Failed to sync persister file " << fileName << endl;
+        }
+        ioTracker.Reset();
+        (void)ftruncate(output, fileOffset);
+        close(output);
+        output = -1;
+    }
+    if (directOutput >= 0) {
+        close(directOutput);
+        directOutput = -1;
+    }
+    if (indexOutput >= 0) {
+        close(indexOutput);
+        indexOutput = -1;
+    }
+}
+
+/*
+ * In the sync modes the data synced is clean and its page cache is dropped right away.
+ * PERSIST_SYNC_NONE only starts the writeback of each PERSIST_SYNC_BYTES with sync_file_range
+ * and drops the cache of the window before it, which has mostly been written back by then.
+ * Either way persisted logs, which are rarely read again, do not push other pages out.
+ */
+void LogPersisterRotator::SyncOutput(bool force)
+{
+    if (output < 0 || fileOffset == syncedOffset) {
+        return;
+    }
+    int fd = output;
+    auto now = chrono::steady_clock::now();
+    if (syncMode == PERSIST_SYNC_NONE) {
+        if (!force && fileOffset - syncedOffset < PERSIST_SYNC_BYTES) {
+            return;
+        }
+        (void)sync_file_range(fd, syncedOffset, fileOffset - syncedOffset, SYNC_FILE_RANGE_WRITE);
+        if (syncedOffset > cachedOffset) {
+            (void)posix_fadvise(fd, cachedOffset, syncedOffset - cachedOffset, POSIX_FADV_DONTNEED);
+            cachedOffset = syncedOffset;
+        }
+        syncedOffset = fileOffset;
+        return;
+    }
+    if (syncMode == PERSIST_SYNC_PERIODIC && !force && fileOffset - syncedOffset < PERSIST_SYNC_BYTES &&
+        now - lastSync < chrono::milliseconds(PERSIST_SYNC_INTERVAL_MS)) {
+        return;
+    }
+    if (ioEngine.Available() && SyncAsync(fd, force)) {
+        lastSync = now;
+        return;
+    }
+    if (fdatasync(fd) != 0) {
+        cout << "Failed to sync persister file " << fileName << " " << strerror(errno) << endl;
+        return;
+    }
+    if (indexOutput >= 0) {
+        (void)fdatasync(indexOutput);
+    }
+    (void)posix_fadvise(fd, cachedOffset, fileOffset - cachedOffset, POSIX_FADV_DONTNEED);
+    cachedOffset = fileOffset;
+    syncedOffset = fileOffset;
+    lastSync = now;
+}
+
+string LogPersisterRotator::SlotName(uint32_t seq)
 {
     stringstream ss;
-    ss << fileName << ".";
-    int pos = ss.tellp();
-    ss << 0 << fileSuffix;
-    remove(ss.str().c_str());
+    ss << fileName << "." << (seq % fileNum) << fileSuffix;
+    return ss.str();
+}
 
-    for (uint32_t i = 1; i < fileNum; ++i) {
-        ss.seekp(pos);
-        ss << (i - 1) << fileSuffix;
-        string newName = ss.str();
-        ss.seekp(pos);
-        ss << i << fileSuffix;
-        string oldName = ss.str();
-        cout << "OLD NAME " << oldName << " NEW NAME " << newName << endl;
-        rename(oldName.c_str(), newName.c_str());
+void LogPersisterRotator::WriteManifest()
+{
+    string baseName = fileName.substr(fileName.find_last_of('/') + 1);
+    uint32_t seq = static_cast<uint32_t>(index);
+    uint32_t oldest = (seq >= fileNum) ? (seq - fileNum + 1) : 0;
+    stringstream ss;
+    for (uint32_t i = oldest; i <= seq; i++) {
+        ss << i << " " << baseName << "." << (i % fileNum) << fileSuffix << "\n";
+    }
+    string manifest = fileName + PERSIST_MANIFEST_SUFFIX;
+    string tmpName = manifest + ".tmp";
+    string content = ss.str();
+    FILE* out = fopen(tmpName.c_str(), "w");
+    bool ok = (out != nullptr) && fwrite(content.data(), 1, content.size(), out) == content.size();
+    if (out != nullptr) {
+        ok = (fflush(out) == 0) && ok;
+        if (syncMode != PERSIST_SYNC_NONE) {
+            ok = (fsync(fileno(out)) == 0) && ok;
+        }
+        fclose(out);
+    }
+    if (!ok || rename(tmpName.c_str(), manifest.c_str()) != 0) {
+        cout << "Failed to update persister manifest " << manifest << endl;
+        remove(tmpName.c_str());
     }
-    output.open(ss.str(), ios::out | ios::trunc);
 }
 
 void LogPersisterRotator::Rotate()
 {
     cout << __func__ << endl;
-    if (index >= (int)(fileNum - 1)) {
-        InternalRotate();
-    } else {
-        index += 1;
-        stringstream ss;
-        ss << fileName << "." << index << fileSuffix;
-        cout << "THE FILE NAME !!!!!!! " << ss.str() << endl;
-        output.open(ss.str(), ios::out | ios::trunc);
+    index += 1;
+    string name = SlotName(index);
+    /* the slot holds the oldest file once all fileNum are written, unlink it so open readers keep theirs */
+    if (static_cast<uint32_t>(index) >= fileNum) {
+        remove(name.c_str());
+        remove((name + PERSIST_INDEX_SUFFIX).c_str());
     }
-    UpdateRotateNumber();
+    OpenOutput(name);
+    WriteManifest();
 }
 
-void LogPersisterRotator::FillInfo(uint32_t *size, uint32_t *num)
+void LogPersisterRotator::FillInfo(uint32_t *size, uint32_t *num, uint16_t *sync)
 {
     *size = fileSize;
     *num = fileNum;
+    *sync = syncMode;
 }
 
 void LogPersisterRotator::FinishInput()
@@ -125,11 +408,6 @@ void LogPersisterRotator::FinishInput()
     needRotate = true;
 }
 
-void LogPersisterRotator::SetIndex(int pIndex)
-{
-    index = pIndex;
-}
-
 void LogPersisterRotator::SetId(uint32_t pId)
 {
     id = pId;
@@ -152,12 +430,6 @@ void LogPersisterRotator::OpenInfoFile()
     }
 }
 
-void LogPersisterRotator::UpdateRotateNumber()
-{
-    info.index = index;
-    WriteRecoveryInfo();
-}
-
 int LogPersisterRotator::SaveInfo(const LogPersistStartMsg& pMsg, const QueryCondition queryCondition)
 {
     info.msg = pMsg;
@@ -174,7 +446,7 @@ int LogPersisterRotator::SaveInfo(const LogPersistStartMsg& pMsg, const QueryCon
 void LogPersisterRotator::WriteRecoveryInfo()
 {
     std::cout << "Save Info file!" << std::endl;
-    uint64_t hash = GetInfoHash(info);
+    uint64_t hash = GetInfoHash(info, sizeof(info));
     fseek(fdinfo, 0, SEEK_SET);
     fwrite(&info, sizeof(PersistRecoveryInfo), 1, fdinfo);
     fwrite(&hash, sizeof(hash), 1, fdinfo);
@@ -15,12 +15,15 @@
 
 #include "log_querier.h"
 #include <chrono>
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <ctime>
 #include <fcntl.h>
 #include <iostream>
 #include <memory>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <thread>
 #include <unistd.h>
@@ -35,6 +38,7 @@
 #include "hilogtool_msg.h"
 #include "log_buffer.h"
 #include "log_persister.h"
+#include "log_querier_reactor.h"
 #include "log_reader.h"
 
 
@@ -46,7 +50,6 @@ string g_logPersisterDir = HILOG_FILE_DIR;
 constexpr int DEFAULT_LOG_LEVEL = 1<<LOG_DEBUG | 1<<LOG_INFO | 1<<LOG_WARN | 1 <<LOG_ERROR | 1 <<LOG_FATAL;
 constexpr int DEFAULT_LOG_TYPE = 1<<LOG_INIT | 1<<LOG_APP | 1<<LOG_CORE;
 constexpr int SLEEP_TIME = 5;
-static char g_tempBuffer[MAX_DATA_LEN] = {0};
 constexpr int INFO_SUFFIX = 5;
 
 inline void SetMsgHead(MessageHeader* msgHeader, uint8_t msgCmd, uint16_t msgLen)
@@ -81,19 +84,20 @@ LogPersisterRotator* MakeRotator(const LogPersistStartMsg& pLogPersistStartMsg)
         pLogPersistStartMsg.filePath,
         pLogPersistStartMsg.fileSize,
         pLogPersistStartMsg.fileNum,
-        fileSuffix);
+        fileSuffix,
+        pLogPersistStartMsg.syncMode);
 }
 
-int JobLauncher(const LogPersistStartMsg& pMsg, const HilogBuffer& buffer, bool restore = false, int index = -1)
+int JobLauncher(const LogPersistStartMsg& pMsg, const HilogBuffer& buffer, bool restore = false)
 {
     LogPersisterRotator* rotator = MakeRotator(pMsg);
     rotator->SetId(pMsg.jobId);
-    rotator->SetIndex(index);
     std::shared_ptr<LogPersister> persister = make_shared<LogPersister>(
         pMsg.jobId,
         pMsg.filePath,
         pMsg.fileSize,
         pMsg.compressAlg,
+        pMsg.fileFormat,
         SLEEP_TIME, *rotator, const_cast<HilogBuffer&>(buffer));
     persister->queryCondition.types = pMsg.logType;
     persister->queryCondition.levels = DEFAULT_LOG_LEVEL;
@@ -125,14 +129,22 @@ void HandleNextRequest(std::shared_ptr<LogReader> logReader, HilogBuffer& buffer
     buffer.Query(logReader);
 }
 
-void HandlePersistStartRequest(char* reqMsg, std::shared_ptr<LogReader> logReader, HilogBuffer& buffer)
+void HandlePersistStartRequest(char* reqMsg, int reqLen, std::shared_ptr<LogQuerier> querier, HilogBuffer& buffer)
 {
     char msgToSend[MAX_DATA_LEN];
     const uint16_t sendMsgLen = sizeof(LogPersistStartResult);
     LogPersistStartRequest* pLogPersistStartReq
         = reinterpret_cast<LogPersistStartRequest*>(reqMsg);
-    LogPersistStartMsg* pLogPersistStartMsg
-        = reinterpret_cast<LogPersistStartMsg*>(&pLogPersistStartReq->logPersistStartMsg);
+    /* fields an older hilogtool does not send keep their defaults */
+    LogPersistStartMsg startMsg;
+    (void)memset_s(&startMsg, sizeof(startMsg), 0, sizeof(startMsg));
+    startMsg.fileFormat = PERSIST_FORMAT_TEXT;
+    startMsg.syncMode = PERSIST_SYNC_NONE;
+    size_t msgLen = (reqLen > static_cast<int>(sizeof(MessageHeader))) ? (reqLen - sizeof(MessageHeader)) : 0;
+    bool lenValid = (msgLen >= PERSIST_START_MSG_V1_LEN) && (memcpy_s(&startMsg, sizeof(startMsg),
+        &pLogPersistStartReq->logPersistStartMsg, min(msgLen, sizeof(startMsg))) == 0);
+    startMsg.filePath[FILE_PATH_MAX_LEN - 1] = '\0';
+    LogPersistStartMsg* pLogPersistStartMsg = &startMsg;
     LogPersistStartResponse* pLogPersistStartRsp
         = reinterpret_cast<LogPersistStartResponse*>(msgToSend);
     LogPersistStartResult* pLogPersistStartRst
@@ -141,11 +153,17 @@ void HandlePersistStartRequest(char* reqMsg, std::shared_ptr<LogReader> logReade
     string logPersisterPath;
     if (pLogPersistStartRst == nullptr) {
         return;
+    } else if (!lenValid) {
+        pLogPersistStartRst->result = ERR_MSG_LEN_INVALID;
     } else if (pLogPersistStartMsg->jobId  <= 0) {
         pLogPersistStartRst->result = ERR_LOG_PERSIST_JOBID_INVALID;
     } else if (pLogPersistStartMsg->fileSize < MAX_PERSISTER_BUFFER_SIZE) {
         cout << "Persist log file size less than min size" << std::endl;
         pLogPersistStartRst->result = ERR_LOG_PERSIST_FILE_SIZE_INVALID;
+    } else if (pLogPersistStartMsg->fileFormat > PERSIST_FORMAT_BINARY) {
+        pLogPersistStartRst->result = ERR_LOG_PERSIST_FILE_FORMAT_INVALID;
+    } else if (pLogPersistStartMsg->syncMode > PERSIST_SYNC_ALWAYS) {
+        pLogPersistStartRst->result = ERR_LOG_PERSIST_SYNC_MODE_INVALID;
     } else if (IsValidFileName(string(pLogPersistStartMsg->filePath)) == false) {
         cout << "FileName is not valid!" << endl;
         pLogPersistStartRst->result = ERR_LOG_PERSIST_FILE_NAME_INVALID;
@@ -161,10 +179,10 @@ void HandlePersistStartRequest(char* reqMsg, std::shared_ptr<LogReader> logReade
 
     pLogPersistStartRst->jobId = pLogPersistStartMsg->jobId;
     SetMsgHead(&pLogPersistStartRsp->msgHeader, MC_RSP_LOG_PERSIST_START, sendMsgLen);
-    logReader->hilogtoolConnectSocket->Write(msgToSend, sendMsgLen + sizeof(MessageHeader));
+    querier->Reply(msgToSend, sendMsgLen + sizeof(MessageHeader));
 }
 
-void HandlePersistDeleteRequest(char* reqMsg, std::shared_ptr<LogReader> logReader)
+void HandlePersistDeleteRequest(char* reqMsg, std::shared_ptr<LogQuerier> querier)
 {
     char msgToSend[MAX_DATA_LEN];
     LogPersistStopRequest* pLogPersistStopReq
@@ -210,11 +228,11 @@ void HandlePersistDeleteRequest(char* reqMsg, std::shared_ptr<LogReader> logRead
     }
     sendMsgLen = msgNum * sizeof(LogPersistStopResult);
     SetMsgHead(&pLogPersistStopRsp->msgHeader, MC_RSP_LOG_PERSIST_STOP, sendMsgLen);
-    logReader->hilogtoolConnectSocket->Write(msgToSend, sendMsgLen + sizeof(MessageHeader));
+    querier->Reply(msgToSend, sendMsgLen + sizeof(MessageHeader));
 }
 
 
-void HandlePersistQueryRequest(char* reqMsg, std::shared_ptr<LogReader> logReader)
+void HandlePersistQueryRequest(char* reqMsg, std::shared_ptr<LogQuerier> querier)
 {
     char msgToSend[MAX_DATA_LEN];
     LogPersistQueryRequest* pLogPersistQueryReq
@@ -251,6 +269,8 @@ void HandlePersistQueryRequest(char* reqMsg, std::shared_ptr<LogReader> logReade
                 }
                 pLogPersistQueryRst->fileSize = (*it).fileSize;
                 pLogPersistQueryRst->fileNum = (*it).fileNum;
+                pLogPersistQueryRst->fileFormat = (*it).fileFormat;
+                pLogPersistQueryRst->syncMode = (*it).syncMode;
                 pLogPersistQueryRst++;
                 msgNum++;
                 if (msgNum * sizeof(LogPersistQueryResult) + sizeof(MessageHeader) > MAX_DATA_LEN) {
@@ -264,10 +284,10 @@ void HandlePersistQueryRequest(char* reqMsg, std::shared_ptr<LogReader> logReade
     }
     sendMsgLen = msgNum * sizeof(LogPersistQueryResult);
     SetMsgHead(&pLogPersistQueryRsp->msgHeader, MC_RSP_LOG_PERSIST_QUERY, sendMsgLen);
-    logReader->hilogtoolConnectSocket->Write(msgToSend, sendMsgLen + sizeof(MessageHeader));
+    querier->Reply(msgToSend, sendMsgLen + sizeof(MessageHeader));
 }
 
-void HandleBufferResizeRequest(char* reqMsg, std::shared_ptr<LogReader> logReader, HilogBuffer* buffer)
+void HandleBufferResizeRequest(char* reqMsg, std::shared_ptr<LogQuerier> querier, HilogBuffer* buffer)
 {
     char msgToSend[MAX_DATA_LEN];
     BufferResizeRequest* pBufferResizeReq = reinterpret_cast<BufferResizeRequest*>(reqMsg);
@@ -299,10 +319,10 @@ void HandleBufferResizeRequest(char* reqMsg, std::shared_ptr<LogReader> logReade
     sendMsgLen = msgNum * sizeof(BuffResizeResult);
     SetMsgHead(&pBufferResizeRsp->msgHeader, MC_RSP_BUFFER_RESIZE, sendMsgLen);
 
-    logReader->hilogtoolConnectSocket->Write(msgToSend, sendMsgLen + sizeof(MessageHeader));
+    querier->Reply(msgToSend, sendMsgLen + sizeof(MessageHeader));
 }
 
-void HandleBufferSizeRequest(char* reqMsg, std::shared_ptr<LogReader> logReader, HilogBuffer* buffer)
+void HandleBufferSizeRequest(char* reqMsg, std::shared_ptr<LogQuerier> querier, HilogBuffer* buffer)
 {
     char msgToSend[MAX_DATA_LEN];
     BufferSizeRequest* pBufferSizeReq = reinterpret_cast<BufferSizeRequest*>(reqMsg);
@@ -334,10 +354,10 @@ void HandleBufferSizeRequest(char* reqMsg, std::shared_ptr<LogReader> logReader,
     sendMsgLen = msgNum * sizeof(BuffSizeResult);
     SetMsgHead(&pBufferSizeRsp->msgHeader, MC_RSP_BUFFER_SIZE, sendMsgLen);
 
-    logReader->hilogtoolConnectSocket->Write(msgToSend, sendMsgLen + sizeof(MessageHeader));
+    querier->Reply(msgToSend, sendMsgLen + sizeof(MessageHeader));
 }
 
-void HandleInfoQueryRequest(char* reqMsg, std::shared_ptr<LogReader> logReader, HilogBuffer* buffer)
+void HandleInfoQueryRequest(char* reqMsg, std::shared_ptr<LogQuerier> querier, HilogBuffer* buffer)
 {
     char msgToSend[MAX_DATA_LEN];
     int32_t rst = 0;
@@ -359,10 +379,10 @@ void HandleInfoQueryRequest(char* reqMsg, std::shared_ptr<LogReader> logReader,
     }
     SetMsgHead(&pStatisticInfoQueryRsp->msgHeader, MC_RSP_STATISTIC_INFO_QUERY, sizeof(StatisticInfoQueryResponse)
         - sizeof(MessageHeader));
-    logReader->hilogtoolConnectSocket->Write(msgToSend, sizeof(StatisticInfoQueryResponse));
+    querier->Reply(msgToSend, sizeof(StatisticInfoQueryResponse));
 }
 
-void HandleInfoClearRequest(char* reqMsg, std::shared_ptr<LogReader> logReader, HilogBuffer* buffer)
+void HandleInfoClearRequest(char* reqMsg, std::shared_ptr<LogQuerier> querier, HilogBuffer* buffer)
 {
     char msgToSend[MAX_DATA_LEN];
     int32_t rst = 0;
@@ -382,10 +402,10 @@ void HandleInfoClearRequest(char* reqMsg, std::shared_ptr<LogReader> logReader,
     }
     SetMsgHead(&pStatisticInfoClearRsp->msgHeader, MC_RSP_STATISTIC_INFO_CLEAR, sizeof(StatisticInfoClearResponse) -
         sizeof(MessageHeader));
-    logReader->hilogtoolConnectSocket->Write(msgToSend, sizeof(StatisticInfoClearResponse));
+    querier->Reply(msgToSend, sizeof(StatisticInfoClearResponse));
 }
 
-void HandleBufferClearRequest(char* reqMsg, std::shared_ptr<LogReader> logReader, HilogBuffer* buffer)
+void HandleBufferClearRequest(char* reqMsg, std::shared_ptr<LogQuerier> querier, HilogBuffer* buffer)
 {
     char msgToSend[MAX_DATA_LEN];
     LogClearRequest* pLogClearReq = reinterpret_cast<LogClearRequest*>(reqMsg);
@@ -415,7 +435,7 @@ void HandleBufferClearRequest(char* reqMsg, std::shared_ptr<LogReader> logReader
 
     uint16_t sendMsgLen = msgNum * sizeof(LogClearResult);
     SetMsgHead(&pLogClearRsp->msgHeader, MC_RSP_LOG_CLEAR, sendMsgLen);
-    logReader->hilogtoolConnectSocket->Write(msgToSend, sendMsgLen + sizeof(MessageHeader));
+    querier->Reply(msgToSend, sendMsgLen + sizeof(MessageHeader));
 }
 
 void SetCondition(std::shared_ptr<LogReader> logReader, const LogQueryRequest& qRstMsg)
@@ -450,88 +470,426 @@ void SetCondition(std::shared_ptr<LogReader> logReader, const LogQueryRequest& q
     }
 }
 
-void LogQuerier::LogQuerierThreadFunc(std::shared_ptr<LogReader> logReader)
+/*
+ * One message from the client, false once it has gone away. Control commands that write files or walk
+ * the whole buffer are offloaded, the others are answered right here.
+ */
+bool LogQuerier::OnReadable()
 {
-    cout << "Start log_querier thread!\n" << std::endl;
-    int readRes = 0;
+    if (!WantRead()) {
+        return true;
+    }
+    std::shared_ptr<LogReader> logReader = shared_from_this();
+    std::shared_ptr<LogQuerier> querier = std::static_pointer_cast<LogQuerier>(logReader);
+    HilogBuffer* buffer = hilogBuffer;
     LogQueryRequest* qRstMsg = nullptr;
     NextRequest* nRstMsg = nullptr;
-
-    while ((readRes = logReader->hilogtoolConnectSocket->Read(g_tempBuffer, MAX_DATA_LEN - 1)) > 0) {
-        MessageHeader *header = (MessageHeader *)g_tempBuffer;
-        switch (header->msgType) {
-            case LOG_QUERY_REQUEST:
-                qRstMsg = (LogQueryRequest*) g_tempBuffer;
-                SetCondition(logReader, *qRstMsg);
-                HandleLogQueryRequest(logReader, *hilogBuffer);
-                break;
-            case NEXT_REQUEST:
-                nRstMsg = (NextRequest*) g_tempBuffer;
-                if (nRstMsg->sendId == SENDIDA) {
-                    HandleNextRequest(logReader, *hilogBuffer);
+    char* reqMsg = request.get();
+    int readRes = hilogtoolConnectSocket->Read(reqMsg, MAX_DATA_LEN - 1);
+    if (readRes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+    if (readRes <= 0) {
+        return false;
+    }
+    MessageHeader *header = (MessageHeader *)reqMsg;
+    switch (header->msgType) {
+        case LOG_QUERY_REQUEST:
+            qRstMsg = (LogQueryRequest*) reqMsg;
+            SetCondition(logReader, *qRstMsg);
+            logReader->queryCondition.matcher = nullptr;
+            if (header->version >= LOG_QUERY_VERSION_FILTER &&
+                static_cast<size_t>(readRes) >= offsetof(LogQueryRequest, regex) + MAX_QUERY_REGEX_LEN &&
+                qRstMsg->regex[0] != 0) {
+                qRstMsg->regex[MAX_QUERY_REGEX_LEN - 1] = 0;
+                logReader->queryCondition.matcher = LogMatcher::Create(qRstMsg->regex);
+            }
+            logReader->queryCondition.beginTime = 0;
+            logReader->queryCondition.endTime = UINT64_MAX;
+            logReader->queryCondition.headCount = 0;
+            logReader->queryCondition.tailCount = 0;
+            logReader->queryCondition.queueLines = 0;
+            logReader->queryCondition.dropPolicy = QUEUE_DROP_OLDEST;
+            logReader->queryCondition.snapshot = false;
+            if (static_cast<size_t>(readRes) >= offsetof(LogQueryRequest, tailLines) + sizeof(uint16_t)) {
+                logReader->queryCondition.beginTime = qRstMsg->beginTime;
+                logReader->queryCondition.endTime = qRstMsg->endTime;
+                /* counts are only right when hilogd matches the pattern as well */
+                if (qRstMsg->regex[0] == 0 || logReader->queryCondition.matcher != nullptr) {
+                    logReader->queryCondition.headCount = qRstMsg->headLines;
+                    logReader->queryCondition.tailCount = qRstMsg->tailLines;
                 }
-                break;
-            case MC_REQ_LOG_PERSIST_START:
-                HandlePersistStartRequest(g_tempBuffer, logReader, *hilogBuffer);
-                break;
-            case MC_REQ_LOG_PERSIST_STOP:
-                HandlePersistDeleteRequest(g_tempBuffer, logReader);
-                break;
-            case MC_REQ_LOG_PERSIST_QUERY:
-                HandlePersistQueryRequest(g_tempBuffer, logReader);
-                break;
-            case MC_REQ_BUFFER_RESIZE:
-                HandleBufferResizeRequest(g_tempBuffer, logReader, hilogBuffer);
-                break;
-            case MC_REQ_BUFFER_SIZE:
-                HandleBufferSizeRequest(g_tempBuffer, logReader, hilogBuffer);
-                break;
-            case MC_REQ_STATISTIC_INFO_QUERY:
-                HandleInfoQueryRequest(g_tempBuffer, logReader, hilogBuffer);
-                break;
-            case MC_REQ_STATISTIC_INFO_CLEAR:
-                HandleInfoClearRequest(g_tempBuffer, logReader, hilogBuffer);
-                break;
-            case MC_REQ_LOG_CLEAR:
-                HandleBufferClearRequest(g_tempBuffer, logReader, hilogBuffer);
-                break;
-            default:
-                break;
+            }
+            if (static_cast<size_t>(readRes) >= offsetof(LogQueryRequest, dropPolicy) + sizeof(uint8_t)) {
+                logReader->queryCondition.queueLines = qRstMsg->queueLines;
+                logReader->queryCondition.dropPolicy = qRstMsg->dropPolicy;
+            }
+            if (static_cast<size_t>(readRes) >= offsetof(LogQueryRequest, snapshot) + sizeof(uint8_t)) {
+                logReader->queryCondition.snapshot = (qRstMsg->snapshot != 0);
+            }
+            if (header->version >= LOG_QUERY_VERSION_STREAM &&
+                static_cast<size_t>(readRes) >= offsetof(LogQueryRequest, credit) + sizeof(uint32_t)) {
+                StartStream(header->version, qRstMsg->credit);
+            } else {
+                /* told of new records through wakeFd, the socket is written on this thread only */
+                (void)OpenWakeFd();
+                HandleLogQueryRequest(logReader, *hilogBuffer);
+            }
+            break;
+        case LOG_QUERY_CREDIT:
+            if (static_cast<size_t>(readRes) >= sizeof(LogQueryCredit)) {
+                GrantCredit(((LogQueryCredit*)reqMsg)->credit);
+            }
+            break;
+        case NEXT_REQUEST:
+            nRstMsg = (NextRequest*) reqMsg;
+            if (nRstMsg->sendId == SENDIDA) {
+                HandleNextRequest(logReader, *hilogBuffer);
+            }
+            break;
+        case MC_REQ_LOG_PERSIST_START:
+            Offload([reqMsg, readRes, querier, buffer] {
+                HandlePersistStartRequest(reqMsg, readRes, querier, *buffer);
+            });
+            break;
+        case MC_REQ_LOG_PERSIST_STOP:
+            Offload([reqMsg, querier] { HandlePersistDeleteRequest(reqMsg, querier); });
+            break;
+        case MC_REQ_LOG_PERSIST_QUERY:
+            HandlePersistQueryRequest(reqMsg, querier);
+            break;
+        case MC_REQ_BUFFER_RESIZE:
+            Offload([reqMsg, querier, buffer] { HandleBufferResizeRequest(reqMsg, querier, buffer); });
+            break;
+        case MC_REQ_BUFFER_SIZE:
+            HandleBufferSizeRequest(reqMsg, querier, hilogBuffer);
+            break;
+        case MC_REQ_STATISTIC_INFO_QUERY:
+            HandleInfoQueryRequest(reqMsg, querier, hilogBuffer);
+            break;
+        case MC_REQ_STATISTIC_INFO_CLEAR:
+            HandleInfoClearRequest(reqMsg, querier, hilogBuffer);
+            break;
+        case MC_REQ_LOG_CLEAR:
+            Offload([reqMsg, querier, buffer] { HandleBufferClearRequest(reqMsg, querier, buffer); });
+            break;
+        default:
+            break;
+    }
+    SendReplies();
+    return true;
+}
+
+/* records the collector added while the query waited for them, or the worker is done */
+void LogQuerier::OnWakeup()
+{
+    uint64_t count = 0;
+    (void)read(wakeFd, &count, sizeof(count));
+    SendReplies();
+    if (streaming) {
+        Pump();
+    } else if (newData.exchange(false)) {
+        LogQueryResponse rsp;
+        rsp.data.sendId = SENDIDS;
+        rsp.data.type = -1;
+        /* set header */
+        SetMsgHead(&(rsp.header), NEXT_RESPONSE, sizeof(rsp));
+        if (WriteData(rsp, nullptr) <= 0) {
+            isNotified = false;
+        }
+    }
+}
+
+bool LogQuerier::OpenWakeFd()
+{
+    if (wakeFd < 0) {
+        wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wakeFd < 0) {
+            cout << "eventfd failed " << strerror(errno) << endl;
         }
     }
-    hilogBuffer->RemoveLogReader(logReader);
+    return wakeFd >= 0;
+}
+
+/*
+ * Runs a control command on the worker of the reactor, so a slow one holds up this client only. No
+ * more requests are read until OnWakeup has its reply, so request is left alone till then and there is
+ * never more than one command of a connection on the worker. Without wakeFd it runs here.
+ */
+void LogQuerier::Offload(std::function<void()> handle)
+{
+    if (!OpenWakeFd()) {
+        handle();
+        return;
+    }
+    busy = true;
+    std::shared_ptr<LogQuerier> querier = std::static_pointer_cast<LogQuerier>(shared_from_this());
+    LogQuerierReactor::GetInstance().Post([querier, handle] {
+        handle();
+        {
+            std::lock_guard<std::mutex> guard(querier->replyLock);
+            querier->jobDone = true;
+        }
+        uint64_t one = 1;
+        (void)write(querier->wakeFd, &one, sizeof(one));
+    });
+}
+
+/* called by the control commands, on the worker as well, the replies go out in SendReplies */
+void LogQuerier::Reply(const char* msg, size_t len)
+{
+    std::lock_guard<std::mutex> guard(replyLock);
+    replies.emplace_back(msg, len);
+}
+
+void LogQuerier::SendReplies()
+{
+    std::list<std::string> ready;
+    {
+        std::lock_guard<std::mutex> guard(replyLock);
+        ready.swap(replies);
+        if (jobDone) {
+            jobDone = false;
+            busy = false;
+        }
+    }
+    for (auto &msg : ready) {
+        iovec vec[1];
+        vec[0].iov_base = &msg[0];
+        vec[0].iov_len = msg.size();
+        (void)Send(vec, 1);
+    }
+}
+
+/* the socket takes messages again, send the ones that waited and go on with the query */
+bool LogQuerier::OnWritable()
+{
+    while (!pendingOut.empty()) {
+        iovec vec[1];
+        vec[0].iov_base = &pendingOut.front()[0];
+        vec[0].iov_len = pendingOut.front().size();
+        int ret = hilogtoolConnectSocket->WriteV(vec, 1);
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        pendingOut.pop_front();
+    }
+    if (disconnecting) {
+        (void)shutdown(hilogtoolConnectSocket->GetHandler(), SHUT_RDWR);
+        return true;
+    }
+    if (streaming) {
+        Pump();
+    }
+    return true;
+}
+
+/* no more requests while a command runs on the worker or a reply waits for the socket */
+bool LogQuerier::WantRead() const
+{
+    return !busy && pendingOut.empty();
+}
+
+bool LogQuerier::WantWrite() const
+{
+    return !pendingOut.empty();
+}
+
+int LogQuerier::GetWakeFd() const
+{
+    return wakeFd;
+}
+
+void LogQuerier::Close()
+{
+    if (lostTotal > 0) {
+        cout << "LogQuerier: client lost " << lostTotal << " lines" << endl;
+    }
+    hilogBuffer->RemoveLogReader(shared_from_this());
 }
 
 LogQuerier::LogQuerier(std::unique_ptr<Socket> handler, HilogBuffer* buffer)
+    : request(std::make_unique<char[]>(MAX_DATA_LEN))
 {
     hilogtoolConnectSocket = std::move(handler);
-    hilogBuffer = buffer;
+    /* shared by every reader, so only store it once: the reactor thread reads it */
+    if (hilogBuffer != buffer) {
+        hilogBuffer = buffer;
+    }
+}
+
+LogQuerier::~LogQuerier()
+{
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+}
+
+/*
+ * From here on records are pushed without a NEXT_REQUEST for each, as far as the client gives credit.
+ * Records the collector adds wake the query through wakeFd, the collector never writes to the socket.
+ */
+void LogQuerier::StartStream(uint8_t clientVersion, uint32_t grant)
+{
+    if (!streaming) {
+        version = (clientVersion >= LOG_QUERY_VERSION_BATCH) ? LOG_QUERY_VERSION_BATCH : LOG_QUERY_VERSION_STREAM;
+        if (clientVersion >= LOG_QUERY_VERSION_FILTER && queryCondition.matcher != nullptr) {
+            /* tells the client it need not match the records once more */
+            version = LOG_QUERY_VERSION_FILTER;
+        }
+        takesLoss = (clientVersion >= LOG_QUERY_VERSION_LOSS);
+        if (version >= LOG_QUERY_VERSION_BATCH) {
+            frame = std::make_unique<char[]>(LOG_QUERY_FRAME_LEN);
+            frameLen = sizeof(LogQueryFrame);
+        }
+        (void)OpenWakeFd();
+        streaming = true;
+        SetCmd(LOG_QUERY_RESPONSE);
+        hilogBuffer->AddLogReader(shared_from_this());
+    }
+    credit = grant;
+    Pump();
+}
+
+void LogQuerier::GrantCredit(uint32_t grant)
+{
+    if (!streaming) {
+        return;
+    }
+    credit += grant;
+    Pump();
+}
+
+/*
+ * Send records until the credit is used up, once it runs out of them Query sends SENDIDN. It also
+ * stops when the socket is full, OnWritable picks up from there.
+ */
+void LogQuerier::Pump()
+{
+    uint16_t head = queryCondition.headCount;
+    while (!disconnecting && pendingOut.empty() && credit > 0 && (head == 0 || sent < head) &&
+        hilogBuffer->Query(shared_from_this())) {
+    }
+    (void)FlushFrame();
+    /* Query is not asked again once the head count is sent, so SENDIDN has to come from here */
+    if (head != 0 && sent >= head && !headEnded && !disconnecting) {
+        headEnded = true;
+        SetSendId(SENDIDN);
+        (void)WriteData(nullptr);
+    }
+}
+
+/*
+ * Called by Query under the buffer lock, so the record is copied: the frame goes out after the lock
+ * is dropped, and then the record may be gone.
+ */
+int LogQuerier::AppendFrame(HilogData* data)
+{
+    size_t recordLen = LOG_QUERY_RECORD_LEN(data->len);
+    if (frameLen + recordLen > LOG_QUERY_FRAME_LEN && FlushFrame() <= 0) {
+        return RET_FAIL;
+    }
+    HilogDataMessage* msg = reinterpret_cast<HilogDataMessage*>(frame.get() + frameLen);
+    msg->sendId = SENDIDA;
+    msg->length = data->len;
+    msg->level = data->level;
+    msg->type = data->type;
+    msg->tag_len = data->tag_len;
+    msg->pid = data->pid;
+    msg->tid = data->tid;
+    msg->domain = data->domain;
+    msg->tv_sec = data->tv_sec;
+    msg->tv_nsec = data->tv_nsec;
+    char* pos = msg->data;
+    size_t room = LOG_QUERY_FRAME_LEN - frameLen - sizeof(HilogDataMessage);
+    if (memcpy_s(pos, room, data->tag, data->tag_len) != 0 ||
+        memcpy_s(pos + data->tag_len, room - data->tag_len, data->content, data->len - data->tag_len) != 0) {
+        return RET_FAIL;
+    }
+    frameLen += recordLen;
+    credit -= recordLen;
+    return recordLen;
+}
+
+/* send the records gathered so far as one message */
+int LogQuerier::FlushFrame()
+{
+    if (frame == nullptr || frameLen == sizeof(LogQueryFrame)) {
+        return 1;
+    }
+    LogQueryFrame* head = reinterpret_cast<LogQueryFrame*>(frame.get());
+    SetMsgHead(&head->header, LOG_QUERY_FRAME, frameLen);
+    head->header.version = version;
+    iovec vec[1];
+    vec[0].iov_base = frame.get();
+    vec[0].iov_len = frameLen;
+    int ret = Send(vec, 1);
+    frameLen = sizeof(LogQueryFrame);
+    if (ret <= 0) {
+        /* a client that went away gets nothing more */
+        credit = 0;
+    }
+    return ret;
+}
+
+/*
+ * Every message to the client goes out here, on the thread of the reactor. The socket does not block,
+ * a message it takes no more of waits in pendingOut, and so does everything after it to keep the order.
+ */
+int LogQuerier::Send(iovec* vec, unsigned int count)
+{
+    if (pendingOut.empty()) {
+        int ret = hilogtoolConnectSocket->WriteV(vec, count);
+        if (ret >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            return ret;
+        }
+    }
+    string msg;
+    for (unsigned int i = 0; i < count; i++) {
+        msg.append(static_cast<const char*>(vec[i].iov_base), vec[i].iov_len);
+    }
+    pendingOut.push_back(std::move(msg));
+    return pendingOut.back().size();
 }
 
 int LogQuerier::WriteData(LogQueryResponse& rsp, HilogData* data)
 {
     iovec vec[3];
+    unsigned int count = 1;
     vec[0].iov_base = &rsp;
     vec[0].iov_len = sizeof(LogQueryResponse);
-    if (data == nullptr) {
-        return hilogtoolConnectSocket->WriteV(vec, 1);
+    if (data != nullptr) {
+        vec[1].iov_base = data->tag;
+        vec[1].iov_len = data->tag_len;
+        vec[2].iov_base = data->content;
+        vec[2].iov_len = data->len - data->tag_len;
+        count = 3;
     }
-    vec[1].iov_base = data->tag;
-    vec[1].iov_len = data->tag_len;
-    vec[2].iov_base = data->content;
-    vec[2].iov_len = data->len - data->tag_len;
-
-    return hilogtoolConnectSocket->WriteV(vec, 3);
+    return Send(vec, count);
 }
 
 int LogQuerier::WriteData(HilogData* data)
 {
+    if (frame != nullptr) {
+        if (data != nullptr) {
+            sent++;
+            return AppendFrame(data);
+        }
+        /* the records go first, SENDIDN tells the client it has seen them all */
+        (void)FlushFrame();
+    }
     LogQueryResponse rsp;
     MessageHeader* header = &(rsp.header);
     HilogDataMessage* msg = &(rsp.data);
 
     /* set header */
     SetMsgHead(header, cmd, sizeof(rsp) + ((data != nullptr) ? data->len : 0));
+    if (streaming) {
+        header->version = version;
+    }
 
     /* set data */
     msg->sendId = sendId;
@@ -547,24 +905,60 @@ int LogQuerier::WriteData(HilogData* data)
         msg->tv_nsec = data->tv_nsec;
     }
 
+    if (data != nullptr) {
+        sent++;
+    }
     /* write into socket */
-    return WriteData(rsp, data);
+    int ret = WriteData(rsp, data);
+    if (streaming && data != nullptr) {
+        /* a client that went away gets nothing more */
+        credit = (ret > 0) ? (credit - header->msgLen) : 0;
+    }
+    return ret;
+}
+
+/*
+ * Called by Query under the buffer lock. The client hears of the loss in between the records, with
+ * closing it is let go after that, as its queue ran over.
+ */
+void LogQuerier::WriteLoss(uint32_t lines, bool closing)
+{
+    lostTotal += lines;
+    if (streaming && takesLoss) {
+        /* the records before the gap go first */
+        (void)FlushFrame();
+        LogQueryLoss loss;
+        SetMsgHead(&loss.header, LOG_QUERY_LOSS, sizeof(loss));
+        loss.header.version = version;
+        loss.lines = lines;
+        iovec vec[1];
+        vec[0].iov_base = &loss;
+        vec[0].iov_len = sizeof(loss);
+        (void)Send(vec, 1);
+    }
+    if (closing) {
+        disconnecting = true;
+        if (pendingOut.empty()) {
+            (void)shutdown(hilogtoolConnectSocket->GetHandler(), SHUT_RDWR);
+        }
+    }
 }
 
 void LogQuerier::NotifyForNewData()
 {
-    if (isNotified) {
+    if (isNotified.exchange(true)) {
         return;
     }
-    isNotified = true;
-    LogQueryResponse rsp;
-    rsp.data.sendId = SENDIDS;
-    rsp.data.type = -1;
-    /* set header */
-    SetMsgHead(&(rsp.header), NEXT_RESPONSE, sizeof(rsp));
-    if (WriteData(rsp, nullptr) <= 0) {
+    /* the collector never writes to the socket, OnWakeup sends or queries on the thread of the reactor */
+    if (wakeFd < 0) {
         isNotified = false;
+        return;
+    }
+    if (!streaming) {
+        newData = true;
     }
+    uint64_t one = 1;
+    (void)write(wakeFd, &one, sizeof(one));
 }
 
 uint8_t LogQuerier::GetType() const
@@ -595,17 +989,28 @@ int LogQuerier::RestorePersistJobs(HilogBuffer& _buffer)
                     std::cout << "Error opening recovery info file!" << std::endl;
                     continue;
                 }
+                /* the info and its hash, of an older hilogd the info is PERSIST_INFO_V1_LEN long */
+                char raw[sizeof(PersistRecoveryInfo) + sizeof(uint64_t)];
+                size_t rawLen = fread(raw, 1, sizeof(raw), infile);
+                fclose(infile);
                 PersistRecoveryInfo info;
-                fread(&info, sizeof(PersistRecoveryInfo), 1, infile);
+                (void)memset_s(&info, sizeof(info), 0, sizeof(info));
+                info.msg.fileFormat = PERSIST_FORMAT_TEXT;
+                info.msg.syncMode = PERSIST_SYNC_NONE;
+                size_t infoLen = (rawLen == sizeof(raw)) ? sizeof(PersistRecoveryInfo) : PERSIST_INFO_V1_LEN;
                 uint64_t hashSum = 0L;
-                fread(&hashSum, sizeof(hashSum), 1, infile);
-                fclose(infile);
-                uint64_t hash = GetInfoHash(info);
+                if ((rawLen != sizeof(raw) && rawLen != PERSIST_INFO_V1_LEN + sizeof(hashSum)) ||
+                    memcpy_s(&info, sizeof(info), raw, infoLen) != 0 ||
+                    memcpy_s(&hashSum, sizeof(hashSum), raw + infoLen, sizeof(hashSum)) != 0) {
+                    std::cout << "Info file size invalid!" << std::endl;
+                    continue;
+                }
+                uint64_t hash = GetInfoHash(info, infoLen);
                 if (hash != hashSum) {
                     std::cout << "Info file checksum Failed!" << std::endl;
                     continue;
                 }
-                JobLauncher(info.msg, _buffer, true, info.index + 1);
+                JobLauncher(info.msg, _buffer, true);
                 std::cout << "Recovery Info:" << std::endl <<
                 "jobId=" << (unsigned)(info.msg.jobId) << std::endl <<
                 "filePath=" << (info.msg.filePath) << std::endl;
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "log_querier_reactor.h"
+
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace OHOS {
+namespace HiviewDFX {
+using namespace std;
+
+LogQuerierReactor& LogQuerierReactor::GetInstance()
+{
+    /* never destroyed, the reactor thread runs as long as hilogd */
+    static LogQuerierReactor *reactor = new LogQuerierReactor();
+    return *reactor;
+}
+
+LogQuerierReactor::LogQuerierReactor()
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        cout << "epoll_create1 failed " << strerror(errno) << endl;
+        return;
+    }
+    std::thread reactor(&LogQuerierReactor::ThreadFunc, this);
+    reactor.detach();
+    std::thread worker(&LogQuerierReactor::WorkerFunc, this);
+    worker.detach();
+}
+
+void LogQuerierReactor::Post(std::function<void()> job)
+{
+    std::lock_guard<mutex> guard(jobLock);
+    jobs.push_back(std::move(job));
+    jobCv.notify_one();
+}
+
+/* the control commands offloaded by the connections, a slow one keeps the reactor serving the others */
+void LogQuerierReactor::WorkerFunc()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<mutex> guard(jobLock);
+            jobCv.wait(guard, [this] { return !jobs.empty(); });
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+int LogQuerierReactor::Add(unique_ptr<Socket> handler, HilogBuffer* buffer)
+{
+    if (epollFd < 0) {
+        return RET_FAIL;
+    }
+    int fd = handler->GetHandler();
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return RET_FAIL;
+    }
+    auto conn = make_shared<Connection>();
+    conn->querier = make_shared<LogQuerier>(std::move(handler), buffer);
+    conn->sockFd = fd;
+    {
+        std::lock_guard<mutex> guard(lock);
+        connections[fd] = conn;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        cout << "epoll_ctl add failed " << strerror(errno) << endl;
+        std::lock_guard<mutex> guard(lock);
+        connections.erase(fd);
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+void LogQuerierReactor::ThreadFunc()
+{
+    struct epoll_event events[MAX_REACTOR_EVENTS];
+    while (true) {
+        int n = epoll_wait(epollFd, events, MAX_REACTOR_EVENTS, -1);
+        if (n < 0) {
+            if (errno != EINTR) {
+                cout << "epoll_wait failed " << strerror(errno) << endl;
+            }
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            Dispatch(events[i].data.fd, events[i].events);
+        }
+    }
+}
+
+void LogQuerierReactor::Dispatch(int fd, uint32_t events)
+{
+    shared_ptr<Connection> conn;
+    {
+        std::lock_guard<mutex> guard(lock);
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            /* closed by an earlier event of the same round */
+            return;
+        }
+        conn = it->second;
+    }
+    shared_ptr<LogQuerier> querier = conn->querier;
+    bool alive = true;
+    if (fd == conn->wakeFd) {
+        querier->OnWakeup();
+    } else if ((events & (EPOLLHUP | EPOLLERR)) != 0 && !querier->WantRead()) {
+        /* gone while it waited for the worker or for room, what is left for it cannot be sent */
+        alive = false;
+    } else {
+        /* a socket that took the fd of one just closed may see its events, it reads EAGAIN then */
+        if ((events & EPOLLOUT) != 0) {
+            alive = querier->OnWritable();
+        }
+        if (alive && (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+            alive = querier->OnReadable();
+        }
+    }
+    if (alive) {
+        Update(conn);
+    } else {
+        Remove(conn);
+    }
+}
+
+/* follow what the querier waits for now: its eventfd, requests, room in the socket */
+void LogQuerierReactor::Update(shared_ptr<Connection> conn)
+{
+    int wakeFd = conn->querier->GetWakeFd();
+    if (wakeFd >= 0 && conn->wakeFd < 0) {
+        {
+            std::lock_guard<mutex> guard(lock);
+            connections[wakeFd] = conn;
+        }
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) == 0) {
+            conn->wakeFd = wakeFd;
+        } else {
+            std::lock_guard<mutex> guard(lock);
+            connections.erase(wakeFd);
+        }
+    }
+    uint32_t events = (conn->querier->WantRead() ? EPOLLIN : 0) | (conn->querier->WantWrite() ? EPOLLOUT : 0);
+    if (events != conn->events) {
+        struct epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = conn->sockFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->sockFd, &ev) == 0) {
+            conn->events = events;
+        }
+    }
+}
+
+void LogQuerierReactor::Remove(shared_ptr<Connection> conn)
+{
+    (void)epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->sockFd, nullptr);
+    if (conn->wakeFd >= 0) {
+        (void)epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->wakeFd, nullptr);
+    }
+    {
+        std::lock_guard<mutex> guard(lock);
+        connections.erase(conn->sockFd);
+        if (conn->wakeFd >= 0) {
+            connections.erase(conn->wakeFd);
+        }
+    }
+    conn->querier->Close();
+}
+} // namespace HiviewDFX
+} // namespace OHOS
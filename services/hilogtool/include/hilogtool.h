@@ -61,6 +61,15 @@ typedef struct {
     std::string flowQuotaArgs;
     std::string pidArgs;
     std::string algorithmArgs;
+    std::string fileFormatArgs;
+    std::string syncModeArgs;
+    std::string decodeFileArgs;
+    std::string timeRangeArgs;
+    uint64_t beginTime; /* timeRangeArgs in nanoseconds since the epoch */
+    uint64_t endTime;
+    std::string queueArgs;
+    uint32_t queueLines; /* queueArgs, 0 for no limit */
+    uint8_t dropPolicy;
 }  HilogArgs;
 } // namespace HiviewDFX
 } // namespace OHOS
@@ -26,12 +26,13 @@
 
 namespace OHOS {
 namespace HiviewDFX {
-constexpr int RECV_BUF_LEN = MAX_LOG_LEN * 2;
+constexpr int RECV_BUF_LEN = LOG_QUERY_FRAME_LEN; /* a whole LogQueryFrame, the largest message of hilogd */
 
 void SetMsgHead(MessageHeader* msgHeader, const uint8_t msgCmd, const uint16_t msgLen);
 int MultiQuerySplit(const std::string& src, const char& delim, std::vector<std::string>& vec);
 inline void PrintBuffer(void* pBuff, unsigned int nLen);
 void NextRequestOp(SeqPacketSocketClient& controller, uint16_t sendId);
+int32_t ParseQueue(const std::string& queueStr, uint32_t& queueLines, uint8_t& dropPolicy);
 void LogQueryRequestOp(SeqPacketSocketClient& controller, const HilogArgs* context);
 void LogQueryResponseOp(SeqPacketSocketClient& controller, char* recvBuffer, uint32_t bufLen,
     HilogArgs* context, HilogShowFormat format);
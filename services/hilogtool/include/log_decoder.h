@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOG_DECODER_H
+#define LOG_DECODER_H
+
+#include <string>
+#include "hilog_common.h"
+#include "hilogtool_msg.h"
+#include "hilogtool.h"
+#include "persist_format.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+/* "<begin>,<end>" in epoch seconds to nanoseconds, a bound left out is 0 or UINT64_MAX */
+int32_t ParseTimeRange(const std::string& range, uint64_t& beginTime, uint64_t& endTime);
+/* decompress a persisted log file by its suffix, plain files are read as they are, stopping
+ * once at least limit bytes are decoded
+ */
+int32_t ReadPersistFile(const std::string& path, std::string& data, size_t limit);
+/* print the persisted log file context->decodeFileArgs filtered by the query options of context,
+ * binary files are rendered in showFormat and the lines of text files printed as written. With an
+ * index next to the file only the blocks that may hold matching logs are decoded.
+ */
+int32_t DecodePersistFile(const HilogArgs* context, HilogShowFormat showFormat);
+} // namespace HiviewDFX
+} // namespace OHOS
+#endif
@@ -27,6 +27,7 @@
 #include "hilog_common.h"
 #include "hilogtool_msg.h"
 #include "seq_packet_socket_client.h"
+#include "persist_format.h"
 #include "properties.h"
 #include "log_display.h"
 
@@ -125,6 +126,57 @@ uint16_t GetCompressAlg(const std::string& pressAlg)
     return COMPRESS_TYPE_ZLIB;
 }
 
+uint16_t GetFileFormat(const std::string& fileFormatStr)
+{
+    if (fileFormatStr == "" || fileFormatStr == "text") {
+        return PERSIST_FORMAT_TEXT;
+    } else if (fileFormatStr == "binary") {
+        return PERSIST_FORMAT_BINARY;
+    }
+    return 0xffff;
+}
+
+uint16_t GetSyncMode(const std::string& syncModeStr)
+{
+    if (syncModeStr == "" || syncModeStr == "none") {
+        return PERSIST_SYNC_NONE;
+    } else if (syncModeStr == "periodic") {
+        return PERSIST_SYNC_PERIODIC;
+    } else if (syncModeStr == "always") {
+        return PERSIST_SYNC_ALWAYS;
+    }
+    return 0xffff;
+}
+
+/* <lines>[,<policy>] of -q */
+int32_t ParseQueue(const std::string& queueStr, uint32_t& queueLines, uint8_t& dropPolicy)
+{
+    queueLines = 0;
+    dropPolicy = QUEUE_DROP_OLDEST;
+    if (queueStr == "") {
+        return RET_SUCCESS;
+    }
+    size_t comma = queueStr.find(',');
+    std::string lines = queueStr.substr(0, comma);
+    std::string policy = (comma == std::string::npos) ? "" : queueStr.substr(comma + 1);
+    char* endptr = nullptr;
+    unsigned long value = strtoul(lines.c_str(), &endptr, 10);
+    if (lines == "" || *endptr != '\0' || value == 0 || value > UINT32_MAX) {
+        return RET_FAIL;
+    }
+    queueLines = static_cast<uint32_t>(value);
+    if (policy == "" || policy == "oldest") {
+        dropPolicy = QUEUE_DROP_OLDEST;
+    } else if (policy == "newest") {
+        dropPolicy = QUEUE_DROP_NEWEST;
+    } else if (policy == "close") {
+        dropPolicy = QUEUE_DISCONNECT;
+    } else {
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
 uint16_t GetLogLevel(const std::string& logLevelStr, std::string& logLevel)
 {
     if (logLevelStr == "debug" || logLevelStr == "DEBUG" || logLevelStr == "d" || logLevelStr == "D") {
@@ -205,23 +257,128 @@ void LogQueryRequestOp(SeqPacketSocketClient& controller, const HilogArgs* conte
             continue;
         }
     }
+    /* a pattern too long to send is matched here only */
+    if (context->regexArgs.length() < MAX_QUERY_REGEX_LEN) {
+        (void)strncpy_s(logQueryRequest.regex, MAX_QUERY_REGEX_LEN,
+            context->regexArgs.c_str(), context->regexArgs.length());
+    }
+    logQueryRequest.beginTime = context->beginTime;
+    logQueryRequest.endTime = context->endTime;
+    logQueryRequest.headLines = context->headLines;
+    logQueryRequest.tailLines = context->tailLines;
+    logQueryRequest.queueLines = context->queueLines;
+    logQueryRequest.dropPolicy = context->dropPolicy;
+    /* -x reads what there is when it starts, records coming in meanwhile are left out */
+    logQueryRequest.snapshot = context->noBlockMode ? 1 : 0;
+    logQueryRequest.credit = LOG_QUERY_CREDIT_WINDOW;
     SetMsgHead(&logQueryRequest.header, LOG_QUERY_REQUEST, sizeof(LogQueryRequest)-sizeof(MessageHeader));
-    logQueryRequest.header.version = 0;
+    logQueryRequest.header.version = LOG_QUERY_VERSION_LOSS;
     controller.WriteAll((char*)&logQueryRequest, sizeof(LogQueryRequest));
 }
 
+static void LogQueryCreditOp(SeqPacketSocketClient& controller, uint32_t credit)
+{
+    LogQueryCredit logQueryCredit;
+    memset_s(&logQueryCredit, sizeof(logQueryCredit), 0, sizeof(logQueryCredit));
+    SetMsgHead(&logQueryCredit.header, LOG_QUERY_CREDIT, sizeof(LogQueryCredit)-sizeof(MessageHeader));
+    logQueryCredit.header.version = LOG_QUERY_VERSION_STREAM;
+    logQueryCredit.credit = credit;
+    controller.WriteAll((char*)&logQueryCredit, sizeof(LogQueryCredit));
+}
+
+static void ShowTailLines(HilogArgs* context, std::vector<string>& tailBuffer)
+{
+    if (context->tailLines) {
+        while (context->tailLines-- && !tailBuffer.empty()) {
+            cout << tailBuffer.back() << endl;
+            tailBuffer.pop_back();
+        }
+    }
+}
+
+/* the records are shown where they lie in the frame, returns the bytes of them */
+static uint32_t ShowFrame(const char* recvBuffer, int recvLen, HilogArgs* context, HilogShowFormat format,
+    std::vector<string>& tailBuffer)
+{
+    const LogQueryFrame* frame = reinterpret_cast<const LogQueryFrame*>(recvBuffer);
+    size_t end = (frame->header.msgLen < recvLen) ? frame->header.msgLen : recvLen;
+    size_t pos = sizeof(LogQueryFrame);
+    while (pos + sizeof(HilogDataMessage) <= end) {
+        HilogDataMessage* data = reinterpret_cast<HilogDataMessage*>(const_cast<char*>(recvBuffer) + pos);
+        size_t recordLen = LOG_QUERY_RECORD_LEN(data->length);
+        if (pos + sizeof(HilogDataMessage) + data->length > end) {
+            break;
+        }
+        HilogShowLog(format, data, context, tailBuffer);
+        pos += recordLen;
+    }
+    return pos - sizeof(LogQueryFrame);
+}
+
+/* hilogd pushes the records, what they took of the window is given back once it is half used */
+static void LogQueryStreamOp(SeqPacketSocketClient& controller, char* recvBuffer, uint32_t bufLen,
+    HilogArgs* context, HilogShowFormat format, std::vector<string>& tailBuffer)
+{
+    LogQueryResponse* rsp = reinterpret_cast<LogQueryResponse*>(recvBuffer);
+    HilogDataMessage* data = &(rsp->data);
+    uint32_t consumed = 0;
+    int recvLen = bufLen;
+    while (1) {
+        MessageHeader* msgHeader = &(rsp->header);
+        if (msgHeader->msgType == LOG_QUERY_FRAME || (msgHeader->msgType == LOG_QUERY_RESPONSE &&
+            data->sendId == SENDIDA)) {
+            if (msgHeader->msgType == LOG_QUERY_FRAME) {
+                consumed += ShowFrame(recvBuffer, recvLen, context, format, tailBuffer);
+            } else {
+                HilogShowLog(format, data, context, tailBuffer);
+                consumed += msgHeader->msgLen;
+            }
+            if (consumed >= LOG_QUERY_CREDIT_WINDOW / 2) {
+                LogQueryCreditOp(controller, consumed);
+                consumed = 0;
+            }
+        } else if (msgHeader->msgType == LOG_QUERY_RESPONSE && data->sendId == SENDIDN) {
+            if (context->noBlockMode) {
+                ShowTailLines(context, tailBuffer);
+                exit(1);
+            }
+            /* lines are not flushed one by one, show what there is before waiting for more */
+            cout.flush();
+        } else if (msgHeader->msgType == LOG_QUERY_LOSS && !context->tailLines) {
+            /* where the lines are missing, the last ones shown by -z have no place for it */
+            cout << "--------- " << reinterpret_cast<LogQueryLoss*>(recvBuffer)->lines << " lines lost" << '\n';
+        }
+        /* only what the last message filled needs clearing, a frame is far larger than a record */
+        memset_s(recvBuffer, bufLen, 0, recvLen);
+        if ((recvLen = controller.RecvMsg(recvBuffer, bufLen)) <= 0) {
+            fprintf(stderr, "Unexpected EOF %s\n", strerror(errno));
+            exit(1);
+        }
+    }
+}
+
 void LogQueryResponseOp(SeqPacketSocketClient& controller, char* recvBuffer, uint32_t bufLen,
     HilogArgs* context, HilogShowFormat format)
 {
     static std::vector<string> tailBuffer;
     LogQueryResponse* rsp = reinterpret_cast<LogQueryResponse*>(recvBuffer);
     HilogDataMessage* data = &(rsp->data);
+    if (rsp->header.version >= LOG_QUERY_VERSION_FILTER) {
+        /* hilogd sends only the records that match */
+        context->regexArgs.clear();
+    }
+    if (rsp->header.version >= LOG_QUERY_VERSION_STREAM) {
+        LogQueryStreamOp(controller, recvBuffer, bufLen, context, format, tailBuffer);
+        return;
+    }
+    /* hilogd without streaming, every record has to be asked for */
     if (data->sendId != SENDIDN) {
         HilogShowLog(format, data, context, tailBuffer);
     }
     NextRequestOp(controller, SENDIDA);
+    uint32_t clearLen = (bufLen < MSG_MAX_LEN) ? bufLen : MSG_MAX_LEN;
     while(1) {
-        memset_s(recvBuffer, bufLen, 0, bufLen);
+        memset_s(recvBuffer, bufLen, 0, clearLen);
         if (controller.RecvMsg(recvBuffer, bufLen) == 0) {
             fprintf(stderr, "Unexpected EOF %s\n", strerror(errno));
             exit(1);
@@ -232,15 +389,11 @@ void LogQueryResponseOp(SeqPacketSocketClient& controller, char* recvBuffer, uin
             switch (data->sendId) {
                 case SENDIDN:
                     if (context->noBlockMode) {
-                        if (context->tailLines) {
-                            while (context->tailLines-- && !tailBuffer.empty()) {
-                                cout << tailBuffer.back() << endl;
-                                tailBuffer.pop_back();
-                            }
-                        }
+                        ShowTailLines(context, tailBuffer);
                         NextRequestOp(controller, SENDIDN);
                         exit(1);
                     }
+                    cout.flush();
                     break;
                 case SENDIDA:
                     HilogShowLog(format, data, context, tailBuffer);
@@ -426,6 +579,16 @@ int32_t LogPersistOp(SeqPacketSocketClient& controller, uint8_t msgCmd, LogPersi
             }
             pLogPersistStartMsg->compressAlg = (logPersistParam->compressAlgStr == "") ? COMPRESS_TYPE_ZLIB :
             GetCompressAlg(logPersistParam->compressAlgStr);
+            pLogPersistStartMsg->fileFormat = GetFileFormat(logPersistParam->fileFormatStr);
+            if (pLogPersistStartMsg->fileFormat == 0xffff) {
+                cout << ParseErrorCode(ERR_LOG_PERSIST_FILE_FORMAT_INVALID) << endl;
+                return RET_FAIL;
+            }
+            pLogPersistStartMsg->syncMode = GetSyncMode(logPersistParam->syncModeStr);
+            if (pLogPersistStartMsg->syncMode == 0xffff) {
+                cout << ParseErrorCode(ERR_LOG_PERSIST_SYNC_MODE_INVALID) << endl;
+                return RET_FAIL;
+            }
             pLogPersistStartMsg->fileSize = (logPersistParam->fileSizeStr == "") ? fileSizeDefault : GetBuffSize(
                 logPersistParam->fileSizeStr);
             pLogPersistStartMsg->fileNum = (logPersistParam->fileNumStr == "") ? fileNumDefault
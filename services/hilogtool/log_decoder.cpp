@@ -0,0 +1,928 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "log_decoder.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <queue>
+#include <regex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <securec.h>
+#include <zlib.h>
+#ifdef USING_ZSTD_COMPRESS
+#include "zstd.h"
+#endif
+#include "format.h"
+#include "hilog/log.h"
+#include "persist_format.h"
+
+namespace OHOS {
+namespace HiviewDFX {
+using namespace std;
+constexpr int READ_CHUNK = 64 * 1024;
+constexpr uint64_t NS_PER_SEC = 1000000000ULL;
+constexpr uint16_t PERSIST_TYPE_UNKNOWN = UINT16_MAX;
+constexpr size_t DECODE_BATCH_RECORDS = 256;
+constexpr size_t DECODE_QUEUE_BATCHES = 4;
+constexpr size_t DECODE_MAX_THREADS = 16; /* mostly blocked on full queues, so not one per cpu */
+
+static bool HasSuffix(const string& path, const string& suffix)
+{
+    return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+#ifdef USING_ZSTD_COMPRESS
+static int32_t ReadZstdFile(const string& path, string& data, size_t limit)
+{
+    ifstream file(path, ios::in | ios::binary);
+    if (!file.is_open()) {
+        cout << "open " << path << " failed" << endl;
+        return RET_FAIL;
+    }
+    ZSTD_DStream* dstream = ZSTD_createDStream();
+    if (dstream == nullptr) {
+        return RET_FAIL;
+    }
+    vector<char> in(READ_CHUNK);
+    vector<char> out(READ_CHUNK);
+    size_t ret = 0;
+    while (data.size() < limit && (file.read(in.data(), in.size()) || file.gcount() > 0)) {
+        ZSTD_inBuffer input = {in.data(), static_cast<size_t>(file.gcount()), 0};
+        while (input.pos < input.size && data.size() < limit) {
+            ZSTD_outBuffer output = {out.data(), out.size(), 0};
+            ret = ZSTD_decompressStream(dstream, &output, &input);
+            if (ZSTD_isError(ret)) {
+                cout << path << ": " << ZSTD_getErrorName(ret) << endl;
+                ZSTD_freeDStream(dstream);
+                return RET_FAIL;
+            }
+            data.append(out.data(), output.pos);
+        }
+    }
+    ZSTD_freeDStream(dstream);
+    return RET_SUCCESS;
+}
+#endif
+
+int32_t ReadPersistFile(const string& path, string& data, size_t limit)
+{
+    if (HasSuffix(path, ".zst")) {
+#ifdef USING_ZSTD_COMPRESS
+        return ReadZstdFile(path, data, limit);
+#else
+        cout << path << ": zstd is not supported by this build" << endl;
+        return RET_FAIL;
+#endif
+    }
+    /* gzread passes files without a gzip header through unchanged */
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        cout << "open " << path << " failed" << endl;
+        return RET_FAIL;
+    }
+    vector<char> chunk(READ_CHUNK);
+    int len = 0;
+    while (data.size() < limit && (len = gzread(file, chunk.data(), chunk.size())) > 0) {
+        data.append(chunk.data(), len);
+    }
+    if (len < 0) {
+        /* the file being written by hilogd has no gzip trailer yet, keep what was flushed */
+        int err = 0;
+        cout << path << ": " << gzerror(file, &err) << ", " << data.size() << " bytes decoded" << endl;
+    }
+    gzclose(file);
+    return RET_SUCCESS;
+}
+
+static int32_t ReadPersistIndex(const string& path, vector<PersistIndexEntry>& index)
+{
+    ifstream file(path, ios::in | ios::binary);
+    if (!file.is_open()) {
+        return RET_FAIL;
+    }
+    PersistIndexHeader header;
+    if (!file.read((char *)&header, sizeof(header)) ||
+        memcmp(header.magic, PERSIST_INDEX_MAGIC, PERSIST_MAGIC_LEN) != 0 || header.entryLen == 0) {
+        cout << path << ": not a log file index" << endl;
+        return RET_FAIL;
+    }
+    vector<char> raw(header.entryLen);
+    /* a short read is an entry torn by a crash, it is the last one */
+    while (file.read(raw.data(), raw.size())) {
+        PersistIndexEntry entry;
+        PersistIndexSetUnknown(entry);
+        if (memcpy_s(&entry, sizeof(entry), raw.data(), min<size_t>(sizeof(entry), raw.size())) != 0) {
+            return RET_FAIL;
+        }
+        index.push_back(entry);
+    }
+    return RET_SUCCESS;
+}
+
+typedef struct {
+    uint64_t beginTime;
+    uint64_t endTime;
+    uint16_t levels;
+    uint16_t types;
+    vector<uint32_t> pids;
+    vector<uint32_t> noPids;
+    vector<uint32_t> domains;
+    vector<uint32_t> noDomains;
+    vector<string> tags;
+    vector<string> noTags;
+    bool hasRegex;
+    regex regExp;
+} PersistFilter;
+
+/* one decoded record, tag and content point into the data it was decoded from */
+typedef struct {
+    uint64_t time;
+    uint16_t type; /* PERSIST_TYPE_UNKNOWN for text files, which do not keep it */
+    uint16_t level;
+    uint32_t pid;
+    uint32_t tid;
+    uint32_t domain;
+    const char *tag;
+    uint32_t tagLen;
+    const char *content;
+    uint32_t contentLen;
+} PersistRecord;
+
+using RecordSink = function<void(const PersistRecord&)>;
+
+/* consecutive records of one file that pass the filter, copied out of the decoded data */
+typedef struct {
+    string arena;
+    vector<PersistRecord> records; /* tag and content are only set once the batch is dequeued */
+    vector<size_t> offsets; /* of the tag of each record in arena */
+} PersistRecordBatch;
+
+static bool Contains(const vector<uint32_t>& values, uint32_t value)
+{
+    return find(values.begin(), values.end(), value) != values.end();
+}
+
+static bool ContainsTag(const vector<string>& tags, const char *tag, uint32_t tagLen)
+{
+    return any_of(tags.begin(), tags.end(), [tag, tagLen](const string& value) {
+        return value.size() == tagLen && value.compare(0, tagLen, tag, tagLen) == 0;
+    });
+}
+
+static int32_t BuildPersistFilter(const HilogArgs* context, PersistFilter& filter)
+{
+    filter.levels = (context->levels != 0) ? context->levels : UINT16_MAX;
+    filter.levels &= ~context->noLevels;
+    filter.types = (context->types != 0) ? context->types : UINT16_MAX;
+    filter.types &= ~context->noTypes;
+    for (int i = 0; i < context->nPid; i++) {
+        filter.pids.push_back(strtoul(context->pids[i].c_str(), nullptr, 10));
+    }
+    for (int i = 0; i < context->nNoPid; i++) {
+        filter.noPids.push_back(strtoul(context->noPids[i].c_str(), nullptr, 10));
+    }
+    for (int i = 0; i < context->nDomain; i++) {
+        filter.domains.push_back(strtoul(context->domains[i].c_str(), nullptr, DOMAIN_NUMBER_BASE));
+    }
+    for (int i = 0; i < context->nNoDomain; i++) {
+        filter.noDomains.push_back(strtoul(context->noDomains[i].c_str(), nullptr, DOMAIN_NUMBER_BASE));
+    }
+    for (int i = 0; i < context->nTag; i++) {
+        filter.tags.push_back(context->tags[i]);
+    }
+    for (int i = 0; i < context->nNoTag; i++) {
+        filter.noTags.push_back(context->noTags[i]);
+    }
+    filter.hasRegex = (context->regexArgs != "");
+    if (filter.hasRegex) {
+        try {
+            filter.regExp = regex(context->regexArgs);
+        } catch (const regex_error& e) {
+            cout << "Invalid regular expression " << context->regexArgs << ": " << e.what() << endl;
+            return RET_FAIL;
+        }
+    }
+    filter.beginTime = context->beginTime;
+    filter.endTime = context->endTime;
+    return RET_SUCCESS;
+}
+
+int32_t ParseTimeRange(const string& range, uint64_t& beginTime, uint64_t& endTime)
+{
+    beginTime = 0;
+    endTime = UINT64_MAX;
+    if (range == "") {
+        return RET_SUCCESS;
+    }
+    size_t comma = range.find(',');
+    string begin = range.substr(0, comma);
+    string end = (comma == string::npos) ? "" : range.substr(comma + 1);
+    char* endptr = nullptr;
+    if (begin != "") {
+        beginTime = static_cast<uint64_t>(strtod(begin.c_str(), &endptr) * NS_PER_SEC);
+        if (*endptr != '\0') {
+            cout << "Invalid time range " << range << endl;
+            return RET_FAIL;
+        }
+    }
+    if (end != "") {
+        endTime = static_cast<uint64_t>(strtod(end.c_str(), &endptr) * NS_PER_SEC);
+        if (*endptr != '\0') {
+            cout << "Invalid time range " << range << endl;
+            return RET_FAIL;
+        }
+    }
+    return RET_SUCCESS;
+}
+
+static bool BlockMatch(const PersistIndexEntry& entry, const PersistFilter& filter)
+{
+    if (entry.maxTime < filter.beginTime || entry.minTime > filter.endTime) {
+        return false;
+    }
+    if ((entry.levels & filter.levels) == 0 || (entry.types & filter.types) == 0) {
+        return false;
+    }
+    if (!filter.pids.empty() && none_of(filter.pids.begin(), filter.pids.end(),
+        [&entry](uint32_t pid) { return (entry.pidBits & PersistPidBit(pid)) != 0; })) {
+        return false;
+    }
+    if (!filter.domains.empty() && none_of(filter.domains.begin(), filter.domains.end(),
+        [&entry](uint32_t domain) { return (entry.domainBits & PersistDomainBit(domain)) != 0; })) {
+        return false;
+    }
+    return true;
+}
+
+static bool RecordMatch(const PersistRecord& record, const PersistFilter& filter)
+{
+    if (record.time < filter.beginTime || record.time > filter.endTime) {
+        return false;
+    }
+    if (((filter.levels >> record.level) & 1) == 0) {
+        return false;
+    }
+    if (record.type != PERSIST_TYPE_UNKNOWN && ((filter.types >> record.type) & 1) == 0) {
+        return false;
+    }
+    if ((!filter.pids.empty() && !Contains(filter.pids, record.pid)) || Contains(filter.noPids, record.pid)) {
+        return false;
+    }
+    if ((!filter.domains.empty() && !Contains(filter.domains, record.domain)) ||
+        Contains(filter.noDomains, record.domain)) {
+        return false;
+    }
+    if ((!filter.tags.empty() && !ContainsTag(filter.tags, record.tag, record.tagLen)) ||
+        ContainsTag(filter.noTags, record.tag, record.tagLen)) {
+        return false;
+    }
+    if (filter.hasRegex &&
+        !regex_search(record.content, record.content + record.contentLen, filter.regExp)) {
+        return false;
+    }
+    return true;
+}
+
+static void ShowRecord(const PersistRecord& record, HilogShowFormat showFormat)
+{
+    char line[MAX_TAG_LEN + MAX_LOG_LEN + 1];
+    char buffer[MAX_LOG_LEN * 2];
+    HilogShowFormatBuffer showBuffer;
+    showBuffer.level = record.level;
+    showBuffer.pid = record.pid;
+    showBuffer.tid = record.tid;
+    showBuffer.domain = record.domain;
+    showBuffer.tv_sec = record.time / NS_PER_SEC;
+    showBuffer.tv_nsec = record.time % NS_PER_SEC;
+    if (memcpy_s(line, sizeof(line), record.tag, record.tagLen) != 0) {
+        return;
+    }
+    uint32_t tagLen = record.tagLen;
+    const char *content = record.content;
+    uint32_t contentLen = record.contentLen;
+    line[tagLen] = '\0';
+    showBuffer.data = line;
+    showBuffer.tag_len = tagLen + 1;
+    uint32_t pos = 0;
+    while (pos < contentLen) {
+        const char *lineEnd = (const char *)memchr(content + pos, '\n', contentLen - pos);
+        uint32_t lineLen = (lineEnd == nullptr) ? (contentLen - pos) : (lineEnd - (content + pos));
+        if (lineLen > 0) {
+            if (memcpy_s(line + tagLen + 1, sizeof(line) - tagLen - 1, content + pos, lineLen) != 0) {
+                return;
+            }
+            line[tagLen + 1 + lineLen] = '\0';
+            HilogShowBuffer(buffer, MAX_LOG_LEN * 2, showBuffer, showFormat);
+            cout << buffer << '\n';
+        }
+        pos += lineLen + 1;
+    }
+}
+
+/* hand the records of data[pos, len), which starts at a block boundary, to sink */
+static int32_t DecodeRecords(const string& path, const string& data, uint32_t pos, uint32_t len,
+    const PersistFilter& filter, const RecordSink& sink)
+{
+    const char *src = data.data();
+    vector<string> tags;
+    uint64_t lastTime = 0;
+    while (pos < len) {
+        uint8_t kind = static_cast<uint8_t>(src[pos++]);
+        if (kind == PERSIST_BLOCK_START) {
+            tags.clear();
+            lastTime = 0;
+            continue;
+        }
+        if ((kind & PERSIST_BLOCK_START) != 0) {
+            break;
+        }
+        uint64_t tagRef = 0;
+        uint64_t tagLen = 0;
+        uint64_t timeDelta = 0;
+        uint64_t pid = 0;
+        uint64_t tid = 0;
+        uint64_t domain = 0;
+        uint64_t contentLen = 0;
+        uint32_t n = GetVarint(src + pos, len - pos, tagRef);
+        const char *tag = nullptr;
+        if (n == 0) {
+            break;
+        }
+        pos += n;
+        if (tagRef == 0) {
+            n = GetVarint(src + pos, len - pos, tagLen);
+            if (n == 0 || tagLen >= MAX_TAG_LEN || pos + n + tagLen > len) {
+                break;
+            }
+            pos += n;
+            tag = src + pos;
+            pos += tagLen;
+            if (tags.size() < PERSIST_MAX_TAGS) {
+                tags.emplace_back(tag, tagLen);
+            }
+        } else if (tagRef <= tags.size()) {
+            tag = tags[tagRef - 1].data();
+            tagLen = tags[tagRef - 1].size();
+        } else {
+            break;
+        }
+        uint64_t *fields[] = {&timeDelta, &pid, &tid, &domain, &contentLen};
+        for (uint64_t *field : fields) {
+            n = GetVarint(src + pos, len - pos, *field);
+            if (n == 0) {
+                break;
+            }
+            pos += n;
+        }
+        if (n == 0 || contentLen > MAX_LOG_LEN || pos + contentLen > len) {
+            break;
+        }
+        lastTime += static_cast<uint64_t>(ZigZagDecode(timeDelta));
+        PersistRecord record = {lastTime, static_cast<uint16_t>((kind >> 3) & 0x0F),
+            static_cast<uint16_t>(kind & 0x07), static_cast<uint32_t>(pid), static_cast<uint32_t>(tid),
+            static_cast<uint32_t>(domain), tag, static_cast<uint32_t>(tagLen), src + pos,
+            static_cast<uint32_t>(contentLen)};
+        if (RecordMatch(record, filter)) {
+            sink(record);
+        }
+        pos += contentLen;
+    }
+    if (pos < len) {
+        cout << path << ": corrupted record at offset " << pos << endl;
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+static bool ParseNumber(const char *&pos, const char *end, int base, uint32_t& value)
+{
+    while (pos < end && *pos == ' ') {
+        pos++;
+    }
+    const char *start = pos;
+    value = 0;
+    for (; pos < end; pos++) {
+        int digit = (*pos >= '0' && *pos <= '9') ? (*pos - '0') :
+            ((base == DOMAIN_NUMBER_BASE && *pos >= 'a' && *pos <= 'f') ? (*pos - 'a' + 10) : -1);
+        if (digit < 0) {
+            break;
+        }
+        value = value * base + digit;
+    }
+    return pos > start;
+}
+
+static bool Expect(const char *&pos, const char *end, char c)
+{
+    if (pos < end && *pos == c) {
+        pos++;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Turns the lines hilogd wrote with the default format back into records. The lines have no year,
+ * it is the one that puts them last before refTime, the time the file was last written.
+ */
+class TextLineParser {
+public:
+    explicit TextLineParser(time_t refTime)
+    {
+        struct tm ref;
+        (void)localtime_r(&refTime, &ref);
+        refYear = ref.tm_year;
+        refDay = ref.tm_mon * 100 + ref.tm_mday;
+    }
+
+    bool Parse(const char *pos, const char *end, PersistRecord& record)
+    {
+        uint32_t month;
+        uint32_t day;
+        uint32_t hour;
+        uint32_t minute;
+        uint32_t second;
+        uint32_t msec;
+        uint32_t level;
+        if (!ParseNumber(pos, end, 10, month) || !Expect(pos, end, '-') || !ParseNumber(pos, end, 10, day) ||
+            !ParseNumber(pos, end, 10, hour) || !Expect(pos, end, ':') || !ParseNumber(pos, end, 10, minute) ||
+            !Expect(pos, end, ':') || !ParseNumber(pos, end, 10, second) || !Expect(pos, end, '.') ||
+            !ParseNumber(pos, end, 10, msec) || !ParseNumber(pos, end, 10, record.pid) ||
+            !ParseNumber(pos, end, 10, record.tid) || !Expect(pos, end, ' ') || pos >= end ||
+            !ParseLevel(*pos++, level) || !ParseNumber(pos, end, DOMAIN_NUMBER_BASE, record.domain) ||
+            !Expect(pos, end, '/')) {
+            return false;
+        }
+        const char *tagEnd = pos;
+        while (tagEnd + 1 < end && !(tagEnd[0] == ':' && tagEnd[1] == ' ')) {
+            tagEnd++;
+        }
+        if (tagEnd + 1 >= end || month == 0) {
+            return false;
+        }
+        const uint64_t nsPerMs = 1000000ULL;
+        record.time = static_cast<uint64_t>(MinuteStart(month - 1, day, hour, minute) + second) * NS_PER_SEC +
+            msec * nsPerMs;
+        record.type = PERSIST_TYPE_UNKNOWN;
+        record.level = static_cast<uint16_t>(level);
+        record.tag = pos;
+        record.tagLen = tagEnd - pos;
+        record.content = tagEnd + 2;
+        record.contentLen = end - record.content;
+        return true;
+    }
+private:
+    static bool ParseLevel(char c, uint32_t& level)
+    {
+        for (uint32_t i = LOG_DEBUG; i < LOG_LEVEL_MAX; i++) {
+            if (ParsedFromLevel(i)[0] == c) {
+                level = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* mktime is slow, lines of one minute share a call */
+    time_t MinuteStart(uint32_t month, uint32_t day, uint32_t hour, uint32_t minute)
+    {
+        uint32_t key = ((month * 100 + day) * 100 + hour) * 100 + minute;
+        if (key == lastKey) {
+            return lastMinute;
+        }
+        struct tm tm;
+        (void)memset_s(&tm, sizeof(tm), 0, sizeof(tm));
+        tm.tm_year = (month * 100 + day > refDay) ? (refYear - 1) : refYear;
+        tm.tm_mon = month;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_min = minute;
+        tm.tm_isdst = -1;
+        lastKey = key;
+        lastMinute = mktime(&tm);
+        return lastMinute;
+    }
+
+    int refYear;
+    uint32_t refDay;
+    uint32_t lastKey = UINT32_MAX;
+    time_t lastMinute = 0;
+};
+
+/* hand the lines of data[pos, len) that pass the filter to sink, or with asWritten print them as they are */
+static void ParseTextLines(const string& path, const string& data, uint32_t pos, uint32_t len,
+    TextLineParser& parser, const PersistFilter& filter, const RecordSink& sink, bool asWritten)
+{
+    const char *src = data.data() + pos;
+    const char *end = data.data() + len;
+    uint32_t skipped = 0;
+    while (src < end) {
+        const char *lineEnd = (const char *)memchr(src, '\n', end - src);
+        lineEnd = (lineEnd == nullptr) ? end : lineEnd;
+        PersistRecord record;
+        if (!parser.Parse(src, lineEnd, record)) {
+            skipped++;
+        } else if (RecordMatch(record, filter)) {
+            if (asWritten) {
+                cout.write(src, lineEnd - src) << '\n';
+            } else {
+                sink(record);
+            }
+        }
+        src = lineEnd + 1;
+    }
+    if (skipped > 0) {
+        cout << path << ": " << skipped << " lines not in the default format skipped" << endl;
+    }
+}
+
+static bool IsBinaryFile(const string& data)
+{
+    return data.size() >= sizeof(PersistFileHeader) && memcmp(data.data(), PERSIST_MAGIC, PERSIST_MAGIC_LEN) == 0;
+}
+
+/* where the blocks of the decompressed file data start, after the header of binary files */
+static int32_t BlocksStart(const string& path, const string& data, uint32_t& pos)
+{
+    pos = 0;
+    if (!IsBinaryFile(data)) {
+        return RET_SUCCESS;
+    }
+    const PersistFileHeader *header = (const PersistFileHeader *)data.data();
+    if (header->version > PERSIST_SCHEMA_VERSION || header->headerLen > data.size()) {
+        cout << path << ": unsupported binary format version " << header->version << endl;
+        return RET_FAIL;
+    }
+    pos = header->headerLen;
+    return RET_SUCCESS;
+}
+
+/* no query option narrows what is shown */
+static bool MatchAll(const PersistFilter& filter)
+{
+    return filter.beginTime == 0 && filter.endTime == UINT64_MAX && filter.levels == UINT16_MAX &&
+        filter.types == UINT16_MAX && filter.pids.empty() && filter.noPids.empty() && filter.domains.empty() &&
+        filter.noDomains.empty() && filter.tags.empty() && filter.noTags.empty() && !filter.hasRegex;
+}
+
+static int32_t DecodeBlocks(const string& path, const string& data, uint32_t pos, uint32_t len,
+    const PersistFilter& filter, const RecordSink& sink, TextLineParser& parser, bool asWritten)
+{
+    /* a text line never starts with a block start byte */
+    if (pos < len && static_cast<uint8_t>(data[pos]) == PERSIST_BLOCK_START) {
+        return DecodeRecords(path, data, pos, len, filter, sink);
+    }
+    if (asWritten && MatchAll(filter)) {
+        cout.write(data.data() + pos, len - pos);
+    } else {
+        ParseTextLines(path, data, pos, len, parser, filter, sink, asWritten);
+    }
+    return RET_SUCCESS;
+}
+
+static int32_t ReadPlainBlock(const string& path, const PersistIndexEntry& entry, string& data)
+{
+    ifstream file(path, ios::in | ios::binary);
+    data.resize(entry.length);
+    if (!file.is_open() || !file.seekg(entry.offset) || !file.read(&data[0], data.size())) {
+        cout << path << ": read block at " << entry.offset << " failed" << endl;
+        return RET_FAIL;
+    }
+    return RET_SUCCESS;
+}
+
+/*
+ * Blocks of an uncompressed file are read straight from their offsets. A compressed file is one stream
+ * that has to be decoded from its start, it is decoded up to the last block that may match and the
+ * blocks that cannot are skipped without parsing.
+ */
+static int32_t DecodeIndexedFile(const string& path, const vector<PersistIndexEntry>& index,
+    const PersistFilter& filter, const RecordSink& sink, TextLineParser& parser, bool asWritten)
+{
+    bool compressed = HasSuffix(path, ".gz") || HasSuffix(path, ".zst");
+    uint64_t plainLen = 0;
+    uint64_t limit = 0;
+    for (auto& entry : index) {
+        plainLen += entry.plainLength;
+        limit = BlockMatch(entry, filter) ? plainLen : limit;
+    }
+    if (limit == 0) {
+        return RET_SUCCESS;
+    }
+    string data;
+    uint32_t pos = 0;
+    if (compressed && (ReadPersistFile(path, data, limit + sizeof(PersistFileHeader)) != RET_SUCCESS ||
+        BlocksStart(path, data, pos) != RET_SUCCESS)) {
+        return RET_FAIL;
+    }
+    int32_t ret = RET_SUCCESS;
+    for (auto& entry : index) {
+        uint32_t start = pos;
+        pos += entry.plainLength;
+        if (!BlockMatch(entry, filter)) {
+            continue;
+        }
+        if (!compressed) {
+            string block;
+            ret = (ReadPlainBlock(path, entry, block) == RET_SUCCESS &&
+                DecodeBlocks(path, block, 0, block.size(), filter, sink, parser, asWritten) == RET_SUCCESS) ?
+                ret : RET_FAIL;
+            continue;
+        }
+        if (pos > data.size()) {
+            cout << path << ": stream ends before the block at " << entry.offset << endl;
+            return RET_FAIL;
+        }
+        if (DecodeBlocks(path, data, start, pos, filter, sink, parser, asWritten) != RET_SUCCESS) {
+            ret = RET_FAIL;
+        }
+    }
+    return ret;
+}
+
+/* hand the records of path that pass the filter to sink, or with asWritten print the matching lines
+ * of text files as they were written
+ */
+static int32_t DecodeFile(const string& path, const PersistFilter& filter, const RecordSink& sink, bool asWritten)
+{
+    struct stat st;
+    TextLineParser parser((stat(path.c_str(), &st) == 0) ? st.st_mtime : time(nullptr));
+    vector<PersistIndexEntry> index;
+    if (ReadPersistIndex(path + PERSIST_INDEX_SUFFIX, index) == RET_SUCCESS) {
+        return DecodeIndexedFile(path, index, filter, sink, parser, asWritten);
+    }
+    string data;
+    uint32_t pos = 0;
+    if (ReadPersistFile(path, data, SIZE_MAX) != RET_SUCCESS || BlocksStart(path, data, pos) != RET_SUCCESS) {
+        return RET_FAIL;
+    }
+    return DecodeBlocks(path, data, pos, data.size(), filter, sink, parser, asWritten);
+}
+
+/*
+ * The batches of every task of a directory on their way from the decoding threads to the merge. A task
+ * queues at most DECODE_QUEUE_BATCHES of them, except while the merge waits for a task no thread has
+ * started yet: the threads may all be blocked on full queues then, so they go on until one finishes.
+ */
+class PersistDirQueues {
+public:
+    explicit PersistDirQueues(size_t taskNum) : tasks(taskNum), next(0), wanted(SIZE_MAX) {}
+
+    bool Start(size_t& i)
+    {
+        lock_guard<mutex> lock(mtx);
+        if (next >= tasks.size()) {
+            return false;
+        }
+        i = next++;
+        return true;
+    }
+
+    void Push(size_t i, PersistRecordBatch& batch)
+    {
+        unique_lock<mutex> lock(mtx);
+        space.wait(lock, [this, i] {
+            return tasks[i].batches.size() < DECODE_QUEUE_BATCHES || (wanted != SIZE_MAX && wanted >= next);
+        });
+        tasks[i].batches.push_back(move(batch));
+        batch = PersistRecordBatch();
+        if (!spare.empty()) {
+            swap(batch, spare.back());
+            spare.pop_back();
+        }
+        ready.notify_one();
+    }
+
+    void Finish(size_t i, int32_t ret)
+    {
+        lock_guard<mutex> lock(mtx);
+        tasks[i].done = true;
+        tasks[i].ret = ret;
+        ready.notify_one();
+    }
+
+    /* the next batch of task i in place of batch, which is done with and kept for reuse, false once
+     * task i has none left
+     */
+    bool Pop(size_t i, PersistRecordBatch& batch)
+    {
+        unique_lock<mutex> lock(mtx);
+        if (batch.arena.capacity() != 0) {
+            batch.arena.clear();
+            batch.records.clear();
+            batch.offsets.clear();
+            spare.push_back(move(batch));
+            batch = PersistRecordBatch();
+        }
+        if (tasks[i].batches.empty() && !tasks[i].done) {
+            wanted = i;
+            space.notify_all();
+            ready.wait(lock, [this, i] { return !tasks[i].batches.empty() || tasks[i].done; });
+            wanted = SIZE_MAX;
+        }
+        if (tasks[i].batches.empty()) {
+            return false;
+        }
+        batch = move(tasks[i].batches.front());
+        tasks[i].batches.pop_front();
+        space.notify_all();
+        lock.unlock();
+        for (size_t n = 0; n < batch.records.size(); n++) {
+            batch.records[n].tag = batch.arena.data() + batch.offsets[n];
+            batch.records[n].content = batch.records[n].tag + batch.records[n].tagLen;
+        }
+        return true;
+    }
+
+    int32_t Result()
+    {
+        lock_guard<mutex> lock(mtx);
+        return any_of(tasks.begin(), tasks.end(), [](const Task& task) { return task.ret != RET_SUCCESS; }) ?
+            RET_FAIL : RET_SUCCESS;
+    }
+
+private:
+    struct Task {
+        deque<PersistRecordBatch> batches;
+        bool done = false;
+        int32_t ret = RET_SUCCESS;
+    };
+    mutex mtx;
+    condition_variable space;
+    condition_variable ready;
+    vector<Task> tasks;
+    vector<PersistRecordBatch> spare;
+    size_t next; /* the first task no thread has started */
+    size_t wanted; /* the task the merge waits for, SIZE_MAX if none */
+};
+
+/* decode the files of task i oldest first, a task writes them one after another so they do not overlap */
+static void QueueTask(const vector<string>& paths, size_t i, const PersistFilter& filter, PersistDirQueues& queues)
+{
+    PersistRecordBatch batch;
+    int32_t ret = RET_SUCCESS;
+    for (auto& path : paths) {
+        ret = (DecodeFile(path, filter, [&batch, i, &queues](const PersistRecord& record) {
+            batch.offsets.push_back(batch.arena.size());
+            batch.arena.append(record.tag, record.tagLen);
+            batch.arena.append(record.content, record.contentLen);
+            batch.records.push_back(record);
+            if (batch.records.size() >= DECODE_BATCH_RECORDS) {
+                queues.Push(i, batch);
+            }
+        }, false) == RET_SUCCESS) ? ret : RET_FAIL;
+    }
+    if (!batch.records.empty()) {
+        queues.Push(i, batch);
+    }
+    queues.Finish(i, ret);
+}
+
+/* the files of every task in dir oldest first as their manifests list them, then any other log file by
+ * name, each as a task of its own
+ */
+static void ListPersistDir(const string& dir, vector<vector<string>>& tasks)
+{
+    vector<string> names;
+    DIR *dp = opendir(dir.c_str());
+    if (dp == nullptr) {
+        return;
+    }
+    struct dirent *ent = nullptr;
+    while ((ent = readdir(dp)) != nullptr) {
+        names.push_back(ent->d_name);
+    }
+    closedir(dp);
+    sort(names.begin(), names.end());
+    set<string> listed;
+    for (auto& name : names) {
+        vector<PersistManifestEntry> files;
+        if (!HasSuffix(name, PERSIST_MANIFEST_SUFFIX) || ReadPersistManifest(dir + name, files) != RET_SUCCESS) {
+            continue;
+        }
+        vector<string> paths;
+        for (auto& file : files) {
+            if (listed.insert(file.name).second) {
+                paths.push_back(dir + file.name);
+            }
+        }
+        if (!paths.empty()) {
+            tasks.push_back(move(paths));
+        }
+    }
+    for (auto& name : names) {
+        struct stat st;
+        if (name[0] == '.' || HasSuffix(name, PERSIST_INDEX_SUFFIX) || HasSuffix(name, PERSIST_MANIFEST_SUFFIX) ||
+            listed.count(name) != 0 || stat((dir + name).c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        tasks.push_back({dir + name});
+    }
+}
+
+/*
+ * The tasks of dir are decoded by a pool of threads into batches of the records that pass the filter,
+ * which are merged by time as they come, records of the same time in the order of their tasks. Only
+ * the file each task is at is decoded at a time, and only a few batches of it wait for the merge.
+ */
+static int32_t DecodePersistDir(const string& path, const PersistFilter& filter, HilogShowFormat showFormat)
+{
+    string dir = HasSuffix(path, "/") ? path : (path + "/");
+    vector<vector<string>> tasks;
+    ListPersistDir(dir, tasks);
+    if (tasks.empty()) {
+        cout << path << ": no log files" << endl;
+        return RET_FAIL;
+    }
+    PersistDirQueues queues(tasks.size());
+    size_t threadNum = min(tasks.size(), DECODE_MAX_THREADS);
+    vector<thread> workers;
+    for (size_t i = 0; i < threadNum; i++) {
+        workers.emplace_back([&tasks, &filter, &queues] {
+            size_t n = 0;
+            while (queues.Start(n)) {
+                QueueTask(tasks[n], n, filter, queues);
+            }
+        });
+    }
+    using Head = pair<uint64_t, size_t>;
+    priority_queue<Head, vector<Head>, greater<Head>> heads;
+    vector<PersistRecordBatch> batches(tasks.size());
+    vector<size_t> cursors(tasks.size(), 0);
+    for (size_t i = 0; i < tasks.size(); i++) {
+        if (queues.Pop(i, batches[i])) {
+            heads.emplace(batches[i].records[0].time, i);
+        }
+    }
+    while (!heads.empty()) {
+        size_t i = heads.top().second;
+        heads.pop();
+        ShowRecord(batches[i].records[cursors[i]], showFormat);
+        if (++cursors[i] >= batches[i].records.size()) {
+            cursors[i] = 0;
+            if (!queues.Pop(i, batches[i])) {
+                continue;
+            }
+        }
+        heads.emplace(batches[i].records[cursors[i]].time, i);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return queues.Result();
+}
+
+int32_t DecodePersistFile(const HilogArgs* context, HilogShowFormat showFormat)
+{
+    const string& path = context->decodeFileArgs;
+    PersistFilter filter;
+    if (BuildPersistFilter(context, filter) != RET_SUCCESS) {
+        return RET_FAIL;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        return DecodePersistDir(path, filter, showFormat);
+    }
+    auto show = [showFormat](const PersistRecord& record) { ShowRecord(record, showFormat); };
+    if (!HasSuffix(path, PERSIST_MANIFEST_SUFFIX)) {
+        return DecodeFile(path, filter, show, true);
+    }
+    vector<PersistManifestEntry> files;
+    if (ReadPersistManifest(path, files) != RET_SUCCESS) {
+        cout << "open " << path << " failed" << endl;
+        return RET_FAIL;
+    }
+    size_t pos = path.find_last_of('/');
+    string dir = (pos == string::npos) ? "" : path.substr(0, pos + 1);
+    int32_t ret = RET_SUCCESS;
+    for (auto& file : files) {
+        ret = (DecodeFile(dir + file.name, filter, show, true) == RET_SUCCESS) ? ret : RET_FAIL;
+    }
+    return ret;
+}
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -23,6 +23,7 @@
 #include <unordered_map>
 #include "hilog/log.h"
 #include "format.h"
+#include "persist_format.h"
 #include "log_controller.h"
 #include "log_display.h"
 
@@ -34,6 +35,7 @@ using hash_t = std::uint64_t;
 
 constexpr hash_t PRIME = 0x100000001B3ull;
 constexpr hash_t BASIS = 0xCBF29CE484222325ull;
+constexpr uint64_t NS_PER_SEC = 1000000000ULL;
 
 unordered_map<uint16_t, std::string> errorMsg
 {
@@ -68,7 +70,10 @@ unordered_map<uint16_t, std::string> errorMsg
     {ERR_FORMAT_INVALID, "Invalid format parameter"},
     {ERR_BUFF_SIZE_INVALID, "Invalid buffer size, buffer size should be more than 0 and less than "
     + to_string(MAX_BUFFER_SIZE)},
-    {ERR_COMMAND_INVALID, "Invalid command, only one control command can be executed each time"}
+    {ERR_COMMAND_INVALID, "Invalid command, only one control command can be executed each time"},
+    {ERR_LOG_PERSIST_FILE_FORMAT_INVALID, "Invalid log persist file format, valid:text/binary"},
+    {ERR_LOG_PERSIST_SYNC_MODE_INVALID, "Invalid log persist sync mode, valid:none/periodic/always"},
+    {ERR_QUERY_QUEUE_INVALID, "Invalid queue, valid:<lines>[,oldest/newest/close]"}
 }; 
 
 string ParseErrorCode(ErrorCode errorCode)
@@ -142,6 +147,18 @@ string GetPressAlgStr(uint16_t pressAlg)
     return pressAlgStr;
 }
 
+string GetSyncModeStr(uint16_t syncMode)
+{
+    string syncModeStr = "none";
+    if (syncMode == PERSIST_SYNC_PERIODIC) {
+        syncModeStr = "periodic";
+    }
+    if (syncMode == PERSIST_SYNC_ALWAYS) {
+        syncModeStr = "always";
+    }
+    return syncModeStr;
+}
+
 string GetByteLenStr(uint64_t buffSize)
 {
     string buffSizeStr;
@@ -363,6 +380,10 @@ int32_t ControlCmdResult(const char* message)
                     outputStr += " ";
                     outputStr += GetPressAlgStr(pLogPersistQueryRst->compressAlg);
                     outputStr += " ";
+                    outputStr += (pLogPersistQueryRst->fileFormat == PERSIST_FORMAT_BINARY) ? "binary" : "text";
+                    outputStr += " ";
+                    outputStr += GetSyncModeStr(pLogPersistQueryRst->syncMode);
+                    outputStr += " ";
                     outputStr += pLogPersistQueryRst->filePath;
                     outputStr += " ";
                     outputStr += to_string(pLogPersistQueryRst->fileSize);
@@ -422,13 +443,17 @@ HilogShowFormat HilogFormat (const char* formatArg)
 }
 
 /*
- * Match the logs according to the regular expression
+ * Match the logs according to the regular expression, for a hilogd that does not match them itself
 */
-bool HilogMatchByRegex(string context, string regExpArg)
+bool HilogMatchByRegex(const char* context, const string& regExpArg)
 {
-    smatch regExpSmatch;
-    regex regExp(regExpArg);
-    if (regex_search(context, regExpSmatch, regExp)) {
+    static string compiledArg;
+    static regex regExp;
+    if (compiledArg != regExpArg) {
+        regExp = regex(regExpArg);
+        compiledArg = regExpArg;
+    }
+    if (regex_search(context, regExp)) {
         return false;
     } else {
         return true;
@@ -451,17 +476,22 @@ void HilogShowLog(HilogShowFormat showFormat, HilogDataMessage* data, HilogArgs*
     HilogShowFormatBuffer showBuffer;
     char* content = data->data + data->tag_len;
 
-    if (context->headLines) {
-        if (printHeadCnt++ >= context->headLines) {
-            exit(1);
-        }
+    /* hilogd without time ranges sends them all */
+    uint64_t time = data->tv_sec * NS_PER_SEC + data->tv_nsec;
+    if (time < context->beginTime || time > context->endTime) {
+        return;
     }
     if (context->regexArgs != "") {
-        string str = content;
-        if (HilogMatchByRegex(str, context->regexArgs)) {
+        if (HilogMatchByRegex(content, context->regexArgs)) {
             return;
         }
     }
+    /* counted after the filters, as hilogd counts them */
+    if (context->headLines) {
+        if (printHeadCnt++ >= context->headLines) {
+            exit(1);
+        }
+    }
 
     char buffer[MAX_LOG_LEN * 2];
     showBuffer.level = data->level;
@@ -485,7 +515,7 @@ void HilogShowLog(HilogShowFormat showFormat, HilogDataMessage* data, HilogArgs*
                     tailBuffer.emplace_back(buffer);
                     return;
                 } else {
-                    cout << buffer << endl;
+                    cout << buffer << '\n';
                 }
                 offset += dataPos - dataBegin + 1;
             } else {
@@ -502,9 +532,13 @@ void HilogShowLog(HilogShowFormat showFormat, HilogDataMessage* data, HilogArgs*
             tailBuffer.emplace_back(buffer);
             return;
         } else {
-            cout << buffer << endl;
+            cout << buffer << '\n';
         }
     }
+    /* hilogd sends no more than the head, do not wait for one past it */
+    if (context->headLines && printHeadCnt >= context->headLines) {
+        exit(1);
+    }
     return;
 }
 } // namespace HiviewDFX
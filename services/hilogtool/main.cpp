@@ -30,6 +30,7 @@
 #include "hilog_common.h"
 #include "hilogtool_msg.h"
 #include "log_controller.h"
+#include "log_decoder.h"
 #include "log_display.h"
 
 namespace OHOS {
@@ -92,6 +93,30 @@ static void Helper()
     "                     none       log file without compressing\n"
     "                     zlib       compress log file by the zlib algorithm\n"
     "                     zstd       compress log file by the zstd algorithm\n"
+    "  -F <file format>, --fileformat=<file format>\n"
+    "                     text       write log file as formatted text lines, the default\n"
+    "                     binary     write log file as compact binary records, read it with -d\n"
+    "  -y <sync mode>, --sync=<sync mode>\n"
+    "                     none       leave log file writeback to the system, the default\n"
+    "                     periodic   sync log file to storage every second or 1MB\n"
+    "                     always     sync log file to storage after every write\n"
+    "  -d <file>, --decode=<file>\n"
+    "                     print a log file written by a writing task, use -v to choose the format.\n"
+    "                     -L, -t, -P, -D, -T, -e and -i select the logs of binary files, with the\n"
+    "                     index of the file only the blocks that may hold them are read.\n"
+    "                     Given <path>.manifest all files of the task are printed, oldest first.\n"
+    "                     Given a directory all log files in it, text ones too, are read in\n"
+    "                     parallel and their logs printed merged by time.\n"
+    "  -i <begin>,<end>, --interval=<begin>,<end>\n"
+    "                     show logs between two epoch times in seconds, either may be left out,\n"
+    "                     of the hilogd buffer as well as of files read with -d.\n"
+    "  -q <lines>[,<policy>], --queue=<lines>[,<policy>]\n"
+    "                     keep at most <lines> new logs waiting for this hilog in hilogd, when it\n"
+    "                     reads slower than they come the policy says which are lost:\n"
+    "                     oldest     drop the oldest logs waiting, the default\n"
+    "                     newest     drop the logs that come while the queue is full\n"
+    "                     close      end the query\n"
+    "                     the number of lost logs is shown where they are missing.\n"
     "  -v <format>, --format=<format> options:\n"
     "                     time       display local time.\n"
     "                     color      display colorful logs by log level.i.e. \x1B[38;5;231mVERBOSE\n"
@@ -207,10 +232,15 @@ int HilogEntry(int argc, char* argv[])
             { "length",      required_argument, nullptr, 'l' },
             { "write",       required_argument, nullptr, 'w' },
             { "baselevel",   required_argument, nullptr, 'b' },
+            { "fileformat",  required_argument, nullptr, 'F' },
+            { "decode",      required_argument, nullptr, 'd' },
+            { "interval",    required_argument, nullptr, 'i' },
+            { "sync",        required_argument, nullptr, 'y' },
+            { "queue",       required_argument, nullptr, 'q' },
             {nullptr, 0, nullptr, 0}
         };
 
-        int choice = getopt_long(argc, argv, "hxz:grsSa:v:e:t:L:G:f:l:n:j:w:p:k:M:D:T:b:Q:m:P:",
+        int choice = getopt_long(argc, argv, "hxz:grsSa:v:e:t:L:G:f:l:n:j:w:p:k:M:D:T:b:Q:m:P:F:d:i:y:q:",
             longOptions, &optIndex);
         if (choice == -1) {
             break;
@@ -460,12 +490,38 @@ int HilogEntry(int argc, char* argv[])
             case 'm':
                 context.algorithmArgs = optarg;
                 break;
+            case 'F':
+                context.fileFormatArgs = optarg;
+                break;
+            case 'd':
+                context.decodeFileArgs = optarg;
+                break;
+            case 'i':
+                context.timeRangeArgs = optarg;
+                break;
+            case 'y':
+                context.syncModeArgs = optarg;
+                break;
+            case 'q':
+                context.queueArgs = optarg;
+                break;
             default:
                 cout << ParseErrorCode(ERR_COMMAND_NOT_FOUND) << endl;
                 exit(1);
         }
     }
 
+    if (ParseTimeRange(context.timeRangeArgs, context.beginTime, context.endTime) != RET_SUCCESS) {
+        exit(-1);
+    }
+    if (ParseQueue(context.queueArgs, context.queueLines, context.dropPolicy) != RET_SUCCESS) {
+        cout << ParseErrorCode(ERR_QUERY_QUEUE_INVALID) << endl;
+        exit(-1);
+    }
+    if (context.decodeFileArgs != "") {
+        exit((DecodePersistFile(&context, showFormat) == RET_SUCCESS) ? 0 : -1);
+    }
+
     SeqPacketSocketClient controller(CONTROL_SOCKET_NAME, 0);
     int controllInit = controller.Init();
     if (controllInit == SeqPacketSocketResult::CREATE_AND_CONNECTED) {
@@ -503,6 +559,8 @@ int HilogEntry(int argc, char* argv[])
             logPersistParam.fileNumStr = context.fileNumArgs;
             logPersistParam.fileNameStr = context.fileNameArgs;
             logPersistParam.jobIdStr = context.jobIdArgs;
+            logPersistParam.fileFormatStr = context.fileFormatArgs;
+            logPersistParam.syncModeStr = context.syncModeArgs;
             if (context.logFileCtrlArgs == "start") {
                 ret = LogPersistOp(controller, MC_REQ_LOG_PERSIST_START, &logPersistParam);
             } else if (context.logFileCtrlArgs == "stop") {
@@ -598,6 +656,8 @@ int HilogEntry(int argc, char* argv[])
         }
 
         case LOG_QUERY_RESPONSE:
+        case LOG_QUERY_FRAME:
+        case LOG_QUERY_LOSS:
         {
             LogQueryResponseOp(controller, recvBuffer, RECV_BUF_LEN, &context, showFormat);
             break;
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "hilog_common.h"
+#include "hilogtool_msg.h"
+#include "log_buffer.h"
+#include "securec.h"
+
+using namespace testing::ext;
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace HiLogdTest {
+static constexpr unsigned int WRITERS = 4;
+static constexpr unsigned int READERS = 6;
+static constexpr unsigned int RECORDS_PER_WRITER = 5000;
+static constexpr unsigned int RECORDS_PER_SEC = 500;
+static constexpr unsigned int ROUNDS_PER_QUERY = 3;
+static constexpr uint32_t BASE_SEC = 1600000000;
+static constexpr uint32_t BASE_PID = 100; /* 100: a pid no test process gets */
+static constexpr uint32_t CORE_BUFFER_SIZE = 300000;
+static constexpr uint32_t APP_BUFFER_SIZE = 100000;
+static constexpr uint32_t APP_BUFFER_SMALL = 60000;
+static constexpr uint32_t QUEUE_LINES = 300;
+static constexpr unsigned int BOUNDED_READERS = 20; /* more than HilogData::wanted has bits for */
+static constexpr unsigned int APP_EVERY = 5; /* every fifth record goes to the smaller buffer */
+static constexpr unsigned int PIN_RECORDS_PER_WRITER = 40000; /* fill a buffer of 2 * MAX_PINNED_BYTES */
+
+/* what a reader got, every writer numbers its records from 0 on */
+class StressReader : public LogReader {
+public:
+    StressReader(bool snapshot, unsigned int variant)
+    {
+        isNotified = false;
+        queryCondition.types = UINT16_MAX;
+        queryCondition.levels = UINT16_MAX;
+        queryCondition.snapshot = snapshot;
+        if (!snapshot && variant % 2 == 1) {
+            queryCondition.queueLines = QUEUE_LINES;
+            queryCondition.dropPolicy = (variant % 4 == 1) ? QUEUE_DROP_OLDEST : QUEUE_DROP_NEWEST;
+        }
+        if (variant % 3 == 1) {
+            queryCondition.nPid = 1;
+            queryCondition.pids[0] = BASE_PID + 1;
+        }
+        for (unsigned int w = 0; w < WRITERS; w++) {
+            last[w] = -1;
+            lastOfType[w][0] = -1;
+            lastOfType[w][1] = -1;
+        }
+    }
+    void NotifyForNewData() override
+    {
+        isNotified = true;
+    }
+    int WriteData(HilogData* data) override
+    {
+        if (data == nullptr) {
+            return 0;
+        }
+        unsigned int writer = data->pid - BASE_PID;
+        long record = strtol(data->content, nullptr, 10);
+        if (writer >= WRITERS || record <= last[writer]) {
+            disorders++;
+            return 1;
+        }
+        last[writer] = record;
+        /* what a snapshot holds of a writer in one buffer has no holes, the buffer lets the oldest go */
+        long &previous = lastOfType[writer][(record % APP_EVERY == 0) ? 1 : 0];
+        if (queryCondition.snapshot && previous >= 0 && record != NextOfType(previous)) {
+            gaps++;
+        }
+        previous = record;
+        got++;
+        return 1;
+    }
+    void WriteLoss(uint32_t lines, bool) override
+    {
+        lost += lines;
+    }
+    uint8_t GetType() const override
+    {
+        return TYPE_QUERIER;
+    }
+    long last[WRITERS];
+    long lastOfType[WRITERS][2]; /* 2: LOG_CORE and LOG_APP */
+    unsigned long got = 0;
+    unsigned long gaps = 0;
+    unsigned long lost = 0;
+    unsigned long disorders = 0;
+private:
+    /* the record a writer writes after record into the same buffer */
+    static long NextOfType(long record)
+    {
+        if (record % APP_EVERY == 0) {
+            return record + APP_EVERY;
+        }
+        long next = record + 1;
+        return (next % APP_EVERY == 0) ? (next + 1) : next;
+    }
+};
+
+class LogBufferTest : public testing::Test {
+public:
+    static void SetUpTestCase() {};
+    static void TearDownTestCase() {};
+    void SetUp() {};
+    void TearDown() {};
+};
+
+static void MakeRecord(HilogMsg *msg, unsigned int writer, unsigned int record)
+{
+    (void)memset_s(msg, sizeof(HilogMsg), 0, sizeof(HilogMsg));
+    msg->type = (record % APP_EVERY == 0) ? LOG_APP : LOG_CORE;
+    msg->level = LOG_INFO;
+    msg->pid = BASE_PID + writer;
+    msg->tid = 1;
+    msg->domain = 0xD002D00 + writer;
+    /* the writers are a second apart now and then, so records come in out of time order as well */
+    msg->tv_sec = BASE_SEC + (record + writer * RECORDS_PER_SEC / WRITERS) / RECORDS_PER_SEC;
+    msg->tv_nsec = record;
+    int tagLen = snprintf_s(msg->tag, MAX_TAG_LEN, MAX_TAG_LEN - 1, "Tag%u", record % 30) + 1; /* 30: tags */
+    int contentLen = snprintf_s(msg->tag + tagLen, MAX_LOG_LEN, MAX_LOG_LEN - 1, "%u from writer %u",
+        record, writer) + 1;
+    msg->tag_len = tagLen;
+    msg->len = sizeof(HilogMsg) + tagLen + contentLen;
+}
+
+/**
+ * @tc.name: Dfx_LogBufferTest_ConcurrentAccess_001
+ * @tc.desc: Several writers, readers and a controller on one buffer at once, to be run under TSan as well.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogBufferTest, ConcurrentAccess_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. WRITERS insert, READERS query again and again with follow, bounded, filtered and
+     *                   snapshot queries, one thread changes the buffer sizes, clears and reads statistics.
+     * @tc.expected: step1. Every reader gets the records of each writer in the order it wrote them, and
+     *                      a snapshot all of them that were in the buffer when it started, evicted or not.
+     */
+    HilogBuffer buffer;
+    ASSERT_EQ(buffer.SetBuffLen(LOG_CORE, CORE_BUFFER_SIZE), CORE_BUFFER_SIZE);
+    ASSERT_EQ(buffer.SetBuffLen(LOG_APP, APP_BUFFER_SIZE), APP_BUFFER_SIZE);
+    std::atomic<bool> stop {false};
+    std::atomic<unsigned long> queries {0};
+    std::atomic<unsigned long> got {0};
+    std::atomic<unsigned long> disorders {0};
+    std::atomic<unsigned long> snapshotGaps {0};
+    std::atomic<unsigned long> snapshotLost {0};
+    std::vector<std::thread> writers;
+    for (unsigned int w = 0; w < WRITERS; w++) {
+        writers.emplace_back([&buffer, w] {
+            char msgBuffer[sizeof(HilogMsg) + MAX_TAG_LEN + MAX_LOG_LEN];
+            HilogMsg *msg = reinterpret_cast<HilogMsg *>(msgBuffer);
+            for (unsigned int i = 0; i < RECORDS_PER_WRITER; i++) {
+                MakeRecord(msg, w, i);
+                if (buffer.Insert(*msg) == 0) {
+                    continue;
+                }
+                buffer.logReaderListMutex.lock_shared();
+                for (auto &itr : buffer.logReaderList) {
+                    std::shared_ptr<LogReader> reader = itr.lock();
+                    if (reader != nullptr) {
+                        reader->NotifyForNewData();
+                    }
+                }
+                buffer.logReaderListMutex.unlock_shared();
+            }
+        });
+    }
+    std::vector<std::thread> readers;
+    for (unsigned int k = 0; k < READERS; k++) {
+        readers.emplace_back([&, k] {
+            while (!stop) {
+                auto reader = std::make_shared<StressReader>(k % 2 == 0, k);
+                buffer.AddLogReader(reader);
+                unsigned int rounds = 0;
+                while (!stop && rounds < ROUNDS_PER_QUERY) {
+                    if (!buffer.Query(reader)) {
+                        rounds++;
+                        std::this_thread::yield();
+                    }
+                }
+                buffer.RemoveLogReader(reader);
+                queries++;
+                got += reader->got;
+                disorders += reader->disorders;
+                snapshotGaps += reader->gaps;
+                snapshotLost += reader->queryCondition.snapshot ? reader->lost : 0;
+            }
+        });
+    }
+    std::thread controller([&buffer, &stop] {
+        unsigned int round = 0;
+        while (!stop) {
+            uint64_t printLen = 0;
+            uint64_t cacheLen = 0;
+            int32_t dropped = 0;
+            (void)buffer.GetStatisticInfoByLog(LOG_CORE, printLen, cacheLen, dropped);
+            (void)buffer.GetStatisticInfoByDomain(0xD002D00, printLen, cacheLen, dropped);
+            (void)buffer.GetBuffLen(LOG_CORE);
+            round++;
+            if (round % 50 == 0) { /* 50: now and then */
+                (void)buffer.SetBuffLen(LOG_APP, (round % 100 == 0) ? APP_BUFFER_SMALL : APP_BUFFER_SIZE);
+            }
+            if (round % 500 == 0) { /* 500: seldom */
+                (void)buffer.Delete(LOG_APP);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200)); /* 200: lets the others run */
+        }
+    });
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    stop = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    controller.join();
+    EXPECT_GT(queries.load(), 0UL);
+    EXPECT_GT(got.load(), 0UL);
+    EXPECT_EQ(disorders.load(), 0UL);
+    EXPECT_EQ(snapshotGaps.load(), 0UL);
+    EXPECT_EQ(snapshotLost.load(), 0UL);
+
+    /**
+     * @tc.steps: step2. Read what is left with one follow query.
+     * @tc.expected: step2. It is in order, and no more than the buffer holds.
+     */
+    auto reader = std::make_shared<StressReader>(false, 0);
+    buffer.AddLogReader(reader);
+    while (buffer.Query(reader)) {
+    }
+    buffer.RemoveLogReader(reader);
+    EXPECT_GT(reader->got, 0UL);
+    EXPECT_LE(reader->got, static_cast<unsigned long>(WRITERS * RECORDS_PER_WRITER));
+    EXPECT_EQ(reader->disorders, 0UL);
+}
+
+/**
+ * @tc.name: Dfx_LogBufferTest_BoundedQueue_001
+ * @tc.desc: A filtered query with queueLines that falls behind while a writer fills the buffer.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogBufferTest, BoundedQueue_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Start a query that takes one writer of WRITERS only, insert without reading, then read.
+     * @tc.expected: step1. What it got and what it was told it lost add up to the records it takes,
+     *                      and no more than QUEUE_LINES of what came in are shown.
+     */
+    HilogBuffer buffer;
+    ASSERT_EQ(buffer.SetBuffLen(LOG_CORE, CORE_BUFFER_SIZE), CORE_BUFFER_SIZE);
+    ASSERT_EQ(buffer.SetBuffLen(LOG_APP, APP_BUFFER_SIZE), APP_BUFFER_SIZE);
+    auto reader = std::make_shared<StressReader>(false, 1);
+    buffer.AddLogReader(reader);
+    EXPECT_FALSE(buffer.Query(reader));
+    char msgBuffer[sizeof(HilogMsg) + MAX_TAG_LEN + MAX_LOG_LEN];
+    HilogMsg *msg = reinterpret_cast<HilogMsg *>(msgBuffer);
+    unsigned long taken = 0;
+    for (unsigned int i = 0; i < RECORDS_PER_WRITER; i++) {
+        for (unsigned int w = 0; w < WRITERS; w++) {
+            MakeRecord(msg, w, i);
+            (void)buffer.Insert(*msg);
+            taken += (msg->pid == BASE_PID + 1) ? 1 : 0;
+        }
+    }
+    reader->NotifyForNewData();
+    while (buffer.Query(reader)) {
+    }
+    buffer.RemoveLogReader(reader);
+    EXPECT_EQ(reader->got + reader->lost, taken);
+    EXPECT_GT(reader->got, 0UL);
+    EXPECT_LE(reader->got, static_cast<unsigned long>(QUEUE_LINES));
+    EXPECT_EQ(reader->disorders, 0UL);
+}
+
+/**
+ * @tc.name: Dfx_LogBufferTest_BoundedQueue_002
+ * @tc.desc: More filtered queries with queueLines at once than HilogData::wanted has bits for.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogBufferTest, BoundedQueue_002, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Start BOUNDED_READERS queries that take one writer of WRITERS only, dropping the
+     *                   oldest or the newest, insert without reading, then read them all.
+     * @tc.expected: step1. For each of them, the ones without a bit too, what it got and what it was told
+     *                      it lost add up to the records it takes, and a full queue of them is shown.
+     */
+    HilogBuffer buffer;
+    ASSERT_EQ(buffer.SetBuffLen(LOG_CORE, CORE_BUFFER_SIZE), CORE_BUFFER_SIZE);
+    ASSERT_EQ(buffer.SetBuffLen(LOG_APP, APP_BUFFER_SIZE), APP_BUFFER_SIZE);
+    std::vector<std::shared_ptr<StressReader>> readers;
+    for (unsigned int k = 0; k < BOUNDED_READERS; k++) {
+        /* 1, 7: variants that filter and drop the oldest or the newest */
+        auto reader = std::make_shared<StressReader>(false, (k % 2 == 0) ? 1 : 7);
+        buffer.AddLogReader(reader);
+        EXPECT_FALSE(buffer.Query(reader));
+        readers.push_back(reader);
+    }
+    char msgBuffer[sizeof(HilogMsg) + MAX_TAG_LEN + MAX_LOG_LEN];
+    HilogMsg *msg = reinterpret_cast<HilogMsg *>(msgBuffer);
+    unsigned long taken = 0;
+    for (unsigned int i = 0; i < RECORDS_PER_WRITER; i++) {
+        for (unsigned int w = 0; w < WRITERS; w++) {
+            MakeRecord(msg, w, i);
+            (void)buffer.Insert(*msg);
+            taken += (msg->pid == BASE_PID + 1) ? 1 : 0;
+        }
+    }
+    for (auto &reader : readers) {
+        reader->NotifyForNewData();
+        while (buffer.Query(reader)) {
+        }
+        buffer.RemoveLogReader(reader);
+        EXPECT_EQ(reader->got + reader->lost, taken);
+        EXPECT_EQ(reader->got, static_cast<unsigned long>(QUEUE_LINES));
+        EXPECT_EQ(reader->disorders, 0UL);
+    }
+}
+
+static void InsertRecords(HilogBuffer &buffer, unsigned int from, unsigned int to)
+{
+    char msgBuffer[sizeof(HilogMsg) + MAX_TAG_LEN + MAX_LOG_LEN];
+    HilogMsg *msg = reinterpret_cast<HilogMsg *>(msgBuffer);
+    for (unsigned int i = from; i < to; i++) {
+        for (unsigned int w = 0; w < WRITERS; w++) {
+            MakeRecord(msg, w, i);
+            (void)buffer.Insert(*msg);
+        }
+    }
+}
+
+/**
+ * @tc.name: Dfx_LogBufferTest_SnapshotPins_001
+ * @tc.desc: A snapshot query whose client stops reading while the buffer lets its records go.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogBufferTest, SnapshotPins_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Fill a buffer of 2 * MAX_PINNED_BYTES, and read all of it with a snapshot query.
+     */
+    HilogBuffer buffer;
+    ASSERT_EQ(buffer.SetBuffLen(LOG_CORE, 2 * MAX_PINNED_BYTES), 2 * MAX_PINNED_BYTES);
+    ASSERT_EQ(buffer.SetBuffLen(LOG_APP, APP_BUFFER_SIZE), APP_BUFFER_SIZE);
+    InsertRecords(buffer, 0, PIN_RECORDS_PER_WRITER);
+    auto whole = std::make_shared<StressReader>(true, 0);
+    buffer.AddLogReader(whole);
+    while (buffer.Query(whole)) {
+    }
+    buffer.RemoveLogReader(whole);
+    ASSERT_GT(whole->got, 0UL);
+    EXPECT_EQ(whole->gaps, 0UL);
+
+    /**
+     * @tc.steps: step2. Start another snapshot query, read one record, then let a full buffer more in.
+     * @tc.expected: step2. It keeps no more than MAX_PINNED_BYTES of what goes, it is told it lost the
+     *                      rest, and what it got and lost add up to what the first one got.
+     */
+    auto stalled = std::make_shared<StressReader>(true, 0);
+    buffer.AddLogReader(stalled);
+    EXPECT_TRUE(buffer.Query(stalled));
+    InsertRecords(buffer, PIN_RECORDS_PER_WRITER, 2 * PIN_RECORDS_PER_WRITER);
+    while (buffer.Query(stalled)) {
+    }
+    buffer.RemoveLogReader(stalled);
+    EXPECT_GT(stalled->lost, 0UL);
+    EXPECT_EQ(stalled->got + stalled->lost, whole->got);
+    EXPECT_EQ(stalled->disorders, 0UL);
+}
+} // namespace HiLogdTest
+} // namespace HiviewDFX
+} // namespace OHOS
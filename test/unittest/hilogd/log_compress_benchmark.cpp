@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "hilog_common.h"
+#include "log_compress.h"
+#include "securec.h"
+
+using namespace testing::ext;
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace HiLogdTest {
+static constexpr unsigned int ROUNDS = 512; /* 32 MB of persister buffers per algorithm */
+static constexpr double BYTES_PER_MB = 1024.0 * 1024.0;
+
+class LogCompressBenchmark : public testing::Test {
+public:
+    static void SetUpTestCase() {};
+    static void TearDownTestCase() {};
+    void SetUp() {};
+    void TearDown() {};
+};
+
+/* a full persister buffer of log lines, as the persister hands them over */
+static std::string MakeText()
+{
+    std::string text;
+    char line[MAX_LOG_LEN] = {0};
+    /* 60 1000 7 13 5 9 37 500: fields that vary the way they do in a real log */
+    for (unsigned int i = 0; text.size() < MAX_PERSISTER_BUFFER_SIZE; i++) {
+        int n = snprintf_s(line, sizeof(line), sizeof(line) - 1,
+            "01-01 00:00:%02u.%03u  %4u  %4u I %05X/Tag%u: request %u finished, cost %ums\n",
+            i % 60, i % 1000, 1000 + i % 7, 2000 + i % 13, 0xD0001 + i % 5, i % 9, i, i * 37 % 500);
+        text.append(line, n);
+    }
+    text.resize(MAX_PERSISTER_BUFFER_SIZE);
+    return text;
+}
+
+/* MB/s of input, the output buffer is emptied after each round as the persister does once it is written */
+static void Measure(const char *name, LogCompress& compressor)
+{
+    std::string text = MakeText();
+    auto buffer = std::make_unique<LogCompressBuffer>();
+    LogCompressBuffer *bufferPtr = buffer.get();
+    uint64_t outLen = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ROUNDS; i++) {
+        bufferPtr->offset = 0;
+        ASSERT_EQ(compressor.Compress(text.data(), text.size(), bufferPtr), 0);
+        outLen += bufferPtr->offset;
+    }
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    double inLen = static_cast<double>(text.size()) * ROUNDS;
+    std::cout << name << ": " << inLen / BYTES_PER_MB / took.count() << " MB/s, ratio "
+        << outLen / inLen << std::endl;
+}
+
+/**
+ * @tc.name: Dfx_LogCompressBenchmark_Throughput_001
+ * @tc.desc: MB/s of Compress for each CompressAlg on full persister buffers of log text.
+ * @tc.type: PERF
+ */
+HWTEST_F(LogCompressBenchmark, Throughput_001, TestSize.Level3)
+{
+    /**
+     * @tc.steps: step1. Compress ROUNDS persister buffers with the compressor of each CompressAlg.
+     * @tc.expected: step1. Every call succeeds, MB/s and the ratio are printed.
+     */
+    NoneCompress none;
+    Measure("COMPRESS_TYPE_NONE", none);
+    ZlibCompress zlib;
+    Measure("COMPRESS_TYPE_ZLIB", zlib);
+#ifdef USING_ZSTD_COMPRESS
+    ZstdCompress zstd;
+    Measure("COMPRESS_TYPE_ZSTD", zstd);
+#endif
+}
+} // namespace HiLogdTest
+} // namespace HiviewDFX
+} // namespace OHOS
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include "hilog_common.h"
+#include "log_compress.h"
+#include "securec.h"
+
+using namespace testing::ext;
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace HiLogdTest {
+static constexpr uint32_t SPAN_LENS[] = { 1, 0, 100, 4096, 17, MAX_PERSISTER_BUFFER_SIZE };
+static constexpr uint32_t ROOM_LEFT = 100;
+
+class LogCompressTest : public testing::Test {
+public:
+    static void SetUpTestCase() {};
+    static void TearDownTestCase() {};
+    void SetUp() {};
+    void TearDown() {};
+};
+
+/* log lines, compress well */
+static std::string MakeText(uint32_t len)
+{
+    std::string text;
+    char line[MAX_LOG_LEN] = {0};
+    /* 60 1000 7 13 5 9 37 500: fields that vary the way they do in a real log */
+    for (unsigned int i = 0; text.size() < len; i++) {
+        int n = snprintf_s(line, sizeof(line), sizeof(line) - 1,
+            "01-01 00:00:%02u.%03u  %4u  %4u I %05X/Tag%u: request %u finished, cost %ums\n",
+            i % 60, i % 1000, 1000 + i % 7, 2000 + i % 13, 0xD0001 + i % 5, i % 9, i, i * 37 % 500);
+        text.append(line, n);
+    }
+    text.resize(len);
+    return text;
+}
+
+/* random bytes, do not compress at all */
+static std::string MakeNoise(uint32_t len)
+{
+    std::string noise(len, '\0');
+    unsigned int seed = 1;
+    for (auto &c : noise) {
+        c = static_cast<char>(rand_r(&seed));
+    }
+    return noise;
+}
+
+/* inflate what ZlibCompress wrote, gzip members one after another */
+static bool Gunzip(const std::string& in, std::string& out)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK) { /* 16: gzip wrapper */
+        return false;
+    }
+    char chunk[MAX_PERSISTER_BUFFER_SIZE];
+    stream.next_in = (Bytef *)in.data();
+    stream.avail_in = in.size();
+    int ret = Z_OK;
+    while (stream.avail_in != 0) {
+        stream.next_out = (Bytef *)chunk;
+        stream.avail_out = sizeof(chunk);
+        ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END) {
+            break;
+        }
+        out.append(chunk, sizeof(chunk) - stream.avail_out);
+        if (ret == Z_STREAM_END) {
+            (void)inflateReset(&stream);
+        }
+    }
+    (void)inflateEnd(&stream);
+    return ret == Z_STREAM_END;
+}
+
+/* each span compressed into an empty output buffer, the outputs written one after another as the rotator does */
+static bool CompressSpans(LogCompress& compressor, const std::string& text, std::string& out)
+{
+    auto buffer = std::make_unique<LogCompressBuffer>();
+    LogCompressBuffer *bufferPtr = buffer.get();
+    uint32_t pos = 0;
+    for (uint32_t len : SPAN_LENS) {
+        bufferPtr->offset = 0;
+        if (compressor.Compress(text.data() + pos, len, bufferPtr) != 0) {
+            return false;
+        }
+        out.append(bufferPtr->content, bufferPtr->offset);
+        pos += len;
+    }
+    bufferPtr->offset = 0;
+    if (compressor.Finish(bufferPtr) != 0) {
+        return false;
+    }
+    out.append(bufferPtr->content, bufferPtr->offset);
+    return true;
+}
+
+static uint32_t SpansLen()
+{
+    uint32_t total = 0;
+    for (uint32_t len : SPAN_LENS) {
+        total += len;
+    }
+    return total;
+}
+
+/**
+ * @tc.name: Dfx_LogCompressTest_Span_001
+ * @tc.desc: NoneCompress copies each span as it is.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogCompressTest, Span_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Compress spans of several lengths, an empty one and a full persister buffer among them.
+     * @tc.expected: step1. The outputs put together are the text.
+     */
+    std::string text = MakeText(SpansLen());
+    NoneCompress compressor;
+    std::string out;
+    ASSERT_TRUE(CompressSpans(compressor, text, out));
+    EXPECT_EQ(out, text);
+}
+
+/**
+ * @tc.name: Dfx_LogCompressTest_Span_002
+ * @tc.desc: ZlibCompress turns the spans into one gzip member, both for text and for input that does not compress.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogCompressTest, Span_002, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Compress spans of log text, then Finish.
+     * @tc.expected: step1. The outputs inflate to the text and are smaller than it.
+     */
+    std::string text = MakeText(SpansLen());
+    ZlibCompress compressor;
+    std::string out;
+    ASSERT_TRUE(CompressSpans(compressor, text, out));
+    std::string inflated;
+    EXPECT_TRUE(Gunzip(out, inflated));
+    EXPECT_EQ(inflated, text);
+    EXPECT_LT(out.size(), text.size());
+
+    /**
+     * @tc.steps: step2. Compress spans of random bytes with the same compressor, then Finish.
+     * @tc.expected: step2. Even a full persister buffer of them fits one LogCompressBuffer, and they inflate back.
+     */
+    std::string noise = MakeNoise(SpansLen());
+    out.clear();
+    ASSERT_TRUE(CompressSpans(compressor, noise, out));
+    inflated.clear();
+    EXPECT_TRUE(Gunzip(out, inflated));
+    EXPECT_EQ(inflated, noise);
+}
+
+/**
+ * @tc.name: Dfx_LogCompressTest_Span_003
+ * @tc.desc: A span that may not fit what is left of the output buffer fails without writing.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogCompressTest, Span_003, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Compress a full persister buffer into an output buffer with ROOM_LEFT bytes free.
+     * @tc.expected: step1. It fails and the output buffer is left as it was.
+     */
+    std::string text = MakeText(MAX_PERSISTER_BUFFER_SIZE);
+    ZlibCompress compressor;
+    auto buffer = std::make_unique<LogCompressBuffer>();
+    LogCompressBuffer *bufferPtr = buffer.get();
+    bufferPtr->offset = MAX_COMPRESS_BUFFER_SIZE - ROOM_LEFT;
+    EXPECT_NE(compressor.Compress(text.data(), text.size(), bufferPtr), 0);
+    EXPECT_EQ(bufferPtr->offset, MAX_COMPRESS_BUFFER_SIZE - ROOM_LEFT);
+
+    /**
+     * @tc.steps: step2. Compress the text into the empty buffer with the same compressor, then Finish.
+     * @tc.expected: step2. A new member starts, it inflates to the text alone.
+     */
+    bufferPtr->offset = 0;
+    ASSERT_EQ(compressor.Compress(text.data(), text.size(), bufferPtr), 0);
+    ASSERT_EQ(compressor.Finish(bufferPtr), 0);
+    std::string inflated;
+    EXPECT_TRUE(Gunzip(std::string(bufferPtr->content, bufferPtr->offset), inflated));
+    EXPECT_EQ(inflated, text);
+}
+} // namespace HiLogdTest
+} // namespace HiviewDFX
+} // namespace OHOS
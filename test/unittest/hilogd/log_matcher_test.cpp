@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdlib>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "log_matcher.h"
+
+using namespace testing::ext;
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace HiLogdTest {
+static constexpr unsigned int PADDING = 40; /* more than two SIMD blocks in front of a literal */
+static constexpr unsigned int RANDOM_TEXTS = 300;
+static constexpr unsigned int RANDOM_TEXT_LEN = 24;
+static const char RANDOM_CHARS[] = "abcdxy019$\\.- _\n";
+
+static const char *LITERALS[] = {
+    "a",
+    "fin",
+    "0123456789abcdef", /* one SIMD block */
+    "0123456789abcdefg",
+    "request 42 finished after the timeout of 500ms",
+};
+
+static const char *PATTERNS[] = {
+    /* anchors, and a $ that is escaped */
+    "^ab", "ab$", "^ab$", "^a.*b$", "^$", "a\\$", "^\\$a", "a\\$$", "a\\\\$", "\\$",
+    /* classes and ranges */
+    "[abc]", "[^abc]x", "[a-c0-9]+", "^[\\d.]+$", "\\w+\\s\\d", "[-a]y", "[a-]", "[^\\n]$", "a.c", "\\D\\W",
+    /* repeats on groups */
+    "(ab)*c", "(ab)+c", "(ab)?c", "x(a|bc)?y", "(?:a|b)+\\$", "^(ab)*$", "(a*b)+d", "a*?b", "(a|)+x",
+    /* alternation */
+    "ab|cd", "a(b|c)d|e", "x|y|\\$", "(0|1)(9|\\.)",
+};
+
+static const char *REJECTED[] = {
+    "a{2}", "a{1,3}", "(a)\\1", "\\bab", "ab\\B", "a(?=b)", "a(?!b)", "(?<=a)b", "^a|b", "a|b$",
+    "\\x41", "\\u0041", "\\cJ", "[[:alpha:]]", "[z-a]", "(ab", "ab)", "a**", "[]", "*a",
+};
+
+static const char *TEXTS[] = {
+    "", "a", "ab", "abc", "xabcx", "ab$", "a$", "$a", "a\\", "ababc", "c", "bcy", "xy", "xay", "xbcy",
+    "x.y", "a\nc", "a\rc", "a-c", "123 45", "hello world 7", "cd", "e", "abd", "-y", "a-", "1.5", "09",
+    "aaab", "bbd", "ababab", "x", "\n", "ab\n", "$", "a.b", "1.2.3",
+};
+
+class LogMatcherTest : public testing::Test {
+public:
+    static void SetUpTestCase() {};
+    static void TearDownTestCase() {};
+    void SetUp() {};
+    void TearDown() {};
+};
+
+static std::vector<std::string> MakeTexts()
+{
+    std::vector<std::string> texts(std::begin(TEXTS), std::end(TEXTS));
+    unsigned int seed = 1;
+    for (unsigned int i = 0; i < RANDOM_TEXTS; i++) {
+        std::string text(rand_r(&seed) % RANDOM_TEXT_LEN, ' ');
+        for (auto &c : text) {
+            c = RANDOM_CHARS[rand_r(&seed) % (sizeof(RANDOM_CHARS) - 1)];
+        }
+        texts.push_back(text);
+    }
+    return texts;
+}
+
+/* the texts a literal is looked for in: at every place up to PADDING, at the end, cut short and with a near miss */
+static std::vector<std::string> MakeLiteralTexts(const std::string &literal)
+{
+    std::vector<std::string> texts;
+    std::string missFirst = literal;
+    missFirst.front() = '#';
+    std::string missLast = literal;
+    missLast.back() = '#';
+    for (unsigned int pad = 0; pad <= PADDING; pad++) {
+        std::string front(pad, '.');
+        texts.push_back(front + literal);
+        texts.push_back(front + literal + front);
+        texts.push_back(front + literal.substr(0, literal.size() - 1));
+        texts.push_back(front + missFirst + front);
+        texts.push_back(front + missLast);
+        texts.push_back(front + literal.substr(1));
+    }
+    return texts;
+}
+
+static void ExpectSameAsRegex(const std::string &pattern, const std::vector<std::string> &texts)
+{
+    std::unique_ptr<LogMatcher> matcher = LogMatcher::Create(pattern);
+    ASSERT_NE(matcher, nullptr) << pattern;
+    std::regex expected(pattern);
+    for (const auto &text : texts) {
+        EXPECT_EQ(matcher->Match(text.data(), text.size()), std::regex_search(text, expected))
+            << "pattern \"" << pattern << "\" text \"" << text << "\"";
+    }
+}
+
+/**
+ * @tc.name: Dfx_LogMatcherTest_Literal_001
+ * @tc.desc: Patterns without meta characters are searched for as they are.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogMatcherTest, Literal_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Look for literals shorter and longer than a SIMD block, at every place of the text,
+     *                   at its end, cut short and with the first or the last byte wrong.
+     * @tc.expected: step1. Match says what std::regex_search says.
+     */
+    for (const char *literal : LITERALS) {
+        ExpectSameAsRegex(literal, MakeLiteralTexts(literal));
+        ExpectSameAsRegex(literal, MakeTexts());
+    }
+
+    /**
+     * @tc.steps: step2. Look for an empty pattern.
+     * @tc.expected: step2. It matches every text, the empty one too.
+     */
+    ExpectSameAsRegex("", MakeTexts());
+}
+
+/**
+ * @tc.name: Dfx_LogMatcherTest_Pattern_001
+ * @tc.desc: Anchors, classes, repeats on groups and alternation are matched as std::regex_search does.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogMatcherTest, Pattern_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Match every pattern against hand picked texts and random ones over the bytes they use.
+     * @tc.expected: step1. Match says what std::regex_search says.
+     */
+    std::vector<std::string> texts = MakeTexts();
+    for (const char *pattern : PATTERNS) {
+        ExpectSameAsRegex(pattern, texts);
+    }
+}
+
+/**
+ * @tc.name: Dfx_LogMatcherTest_Rejected_001
+ * @tc.desc: Patterns beyond the matcher are left to hilogtool.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogMatcherTest, Rejected_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Create matchers for counted repeats, back references, word boundaries, lookarounds,
+     *                   anchors with alternation, other escapes and invalid patterns.
+     * @tc.expected: step1. Create returns nullptr for each of them.
+     */
+    for (const char *pattern : REJECTED) {
+        EXPECT_EQ(LogMatcher::Create(pattern), nullptr) << pattern;
+    }
+}
+} // namespace HiLogdTest
+} // namespace HiviewDFX
+} // namespace OHOS
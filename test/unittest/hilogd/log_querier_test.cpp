@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2021 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "hilog_common.h"
+#include "hilogtool_msg.h"
+#include "log_buffer.h"
+#include "log_querier_reactor.h"
+#include "securec.h"
+#include "socket.h"
+
+using namespace testing::ext;
+
+namespace OHOS {
+namespace HiviewDFX {
+namespace HiLogdTest {
+static constexpr unsigned int RECORDS = 6000;
+static constexpr unsigned int TAGS = 30;
+static constexpr unsigned int PIDS = 7;
+static constexpr unsigned int RECORDS_PER_SEC = 10;
+static constexpr unsigned int CLIENTS = 48;
+static constexpr unsigned int CONTROL_REQUESTS = 2000;
+static constexpr unsigned int CONTROL_REPLY_LEN = 2048;
+static constexpr uint32_t BASE_SEC = 1600000000;
+static constexpr uint64_t NS_PER_SEC = 1000000000ULL;
+
+/* what one client asks for, the times are seconds after BASE_SEC and 0 leaves them open */
+struct QueryCase {
+    const char *regex;
+    uint32_t beginSec;
+    uint32_t endSec;
+    uint16_t headLines;
+    uint16_t tailLines;
+};
+
+static const QueryCase QUERY_CASES[] = {
+    { "", 0, 0, 0, 0 },
+    { "", 0, 0, 10, 0 },
+    { "", 0, 0, 0, 25 },
+    { "number 1", 0, 0, 0, 0 },
+    { "^message number [0-9]*7 ", 0, 0, 0, 0 },
+    { "", 100, 400, 0, 0 },
+    { "payload", 0, 0, 500, 0 },
+    { "", 300, 0, 0, 100 },
+};
+static constexpr unsigned int QUERY_CASE_NUM = sizeof(QUERY_CASES) / sizeof(QUERY_CASES[0]);
+
+class LogQuerierTest : public testing::Test {
+public:
+    static void SetUpTestCase();
+    static void TearDownTestCase() {};
+    void SetUp() {};
+    void TearDown() {};
+    /* the connections of the reactor keep a pointer to it, so it outlives the tests */
+    static HilogBuffer *buffer;
+};
+
+HilogBuffer *LogQuerierTest::buffer = nullptr;
+
+void LogQuerierTest::SetUpTestCase()
+{
+    buffer = new HilogBuffer();
+    char msgBuffer[sizeof(HilogMsg) + MAX_TAG_LEN + MAX_LOG_LEN];
+    HilogMsg *msg = reinterpret_cast<HilogMsg *>(msgBuffer);
+    for (unsigned int i = 0; i < RECORDS; i++) {
+        (void)memset_s(msg, sizeof(HilogMsg), 0, sizeof(HilogMsg));
+        msg->type = LOG_CORE;
+        msg->level = LOG_INFO;
+        msg->pid = 100 + i % PIDS; /* 100: a pid no test process gets */
+        msg->tid = 1;
+        msg->domain = 0xD002D00;
+        msg->tv_sec = BASE_SEC + i / RECORDS_PER_SEC;
+        msg->tv_nsec = i;
+        int tagLen = snprintf_s(msg->tag, MAX_TAG_LEN, MAX_TAG_LEN - 1, "Tag%u", i % TAGS) + 1;
+        int contentLen = snprintf_s(msg->tag + tagLen, MAX_LOG_LEN, MAX_LOG_LEN - 1,
+            "message number %u with some payload", i) + 1;
+        msg->tag_len = tagLen;
+        msg->len = sizeof(HilogMsg) + tagLen + contentLen;
+        buffer->Insert(*msg);
+    }
+}
+
+static void AppendRecord(const HilogDataMessage *data, std::string &out)
+{
+    out += std::to_string(data->tv_sec) + "." + std::to_string(data->tv_nsec) + " " + std::to_string(data->pid) +
+        " " + data->data + ": " + (data->data + data->tag_len) + "\n";
+}
+
+/* runs query as hilog -x does against a connection of the reactor, returns what the client got */
+static std::string RunQuery(HilogBuffer &buffer, const QueryCase &query)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0) {
+        return "socketpair failed";
+    }
+    auto handler = std::make_unique<Socket>(SOCK_SEQPACKET);
+    handler->setHandler(fds[0]);
+    if (LogQuerierReactor::GetInstance().Add(std::move(handler), &buffer) != RET_SUCCESS) {
+        close(fds[1]);
+        return "add failed";
+    }
+    LogQueryRequest request;
+    (void)memset_s(&request, sizeof(request), 0, sizeof(request));
+    request.header.version = LOG_QUERY_VERSION_LOSS;
+    request.header.msgType = LOG_QUERY_REQUEST;
+    request.header.msgLen = sizeof(request) - sizeof(MessageHeader);
+    request.levels = UINT8_MAX;
+    request.types = UINT16_MAX;
+    (void)strcpy_s(request.regex, MAX_QUERY_REGEX_LEN, query.regex);
+    request.beginTime = (query.beginSec == 0) ? 0 : (BASE_SEC + query.beginSec) * NS_PER_SEC;
+    request.endTime = (query.endSec == 0) ? UINT64_MAX : (BASE_SEC + query.endSec) * NS_PER_SEC;
+    request.headLines = query.headLines;
+    request.tailLines = query.tailLines;
+    request.credit = LOG_QUERY_CREDIT_WINDOW;
+    request.snapshot = 1;
+    std::string out;
+    if (send(fds[1], &request, sizeof(request), 0) != sizeof(request)) {
+        close(fds[1]);
+        return "send failed";
+    }
+    std::vector<char> recvBuffer(LOG_QUERY_FRAME_LEN + MSG_MAX_LEN);
+    uint32_t consumed = 0;
+    while (true) {
+        ssize_t len = recv(fds[1], recvBuffer.data(), recvBuffer.size(), 0);
+        if (len < static_cast<ssize_t>(sizeof(MessageHeader))) {
+            out += "unexpected end\n";
+            break;
+        }
+        const MessageHeader *header = reinterpret_cast<const MessageHeader *>(recvBuffer.data());
+        if (header->msgType == LOG_QUERY_FRAME) {
+            size_t end = (header->msgLen < len) ? header->msgLen : len;
+            size_t pos = sizeof(LogQueryFrame);
+            while (pos + sizeof(HilogDataMessage) <= end) {
+                const HilogDataMessage *data = reinterpret_cast<const HilogDataMessage *>(recvBuffer.data() + pos);
+                AppendRecord(data, out);
+                pos += LOG_QUERY_RECORD_LEN(data->length);
+            }
+            consumed += pos - sizeof(LogQueryFrame);
+        } else if (header->msgType == LOG_QUERY_RESPONSE) {
+            const LogQueryResponse *rsp = reinterpret_cast<const LogQueryResponse *>(recvBuffer.data());
+            if (rsp->data.sendId == SENDIDN) {
+                break;
+            }
+            AppendRecord(&rsp->data, out);
+            consumed += header->msgLen;
+        } else if (header->msgType == LOG_QUERY_LOSS) {
+            out += "lost " + std::to_string(reinterpret_cast<const LogQueryLoss *>(header)->lines) + "\n";
+        }
+        if (consumed >= LOG_QUERY_CREDIT_WINDOW / 2) {
+            LogQueryCredit credit = { { LOG_QUERY_VERSION_STREAM, LOG_QUERY_CREDIT,
+                sizeof(LogQueryCredit) - sizeof(MessageHeader) }, consumed };
+            (void)send(fds[1], &credit, sizeof(credit), 0);
+            consumed = 0;
+        }
+    }
+    close(fds[1]);
+    return out;
+}
+
+/**
+ * @tc.name: Dfx_LogQuerierTest_ParallelQueries_001
+ * @tc.desc: Run dozens of different queries at once on the same buffer.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogQuerierTest, ParallelQueries_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Run every query alone, then CLIENTS of them at the same time
+     * @tc.expected: step1. Every client gets what the same query got alone.
+     */
+    std::vector<std::string> expected;
+    for (unsigned int i = 0; i < QUERY_CASE_NUM; i++) {
+        expected.push_back(RunQuery(*buffer, QUERY_CASES[i]));
+        EXPECT_FALSE(expected.back().empty()) << "query " << i;
+    }
+    std::vector<std::string> results(CLIENTS);
+    std::vector<std::thread> clients;
+    for (unsigned int i = 0; i < CLIENTS; i++) {
+        clients.emplace_back([&results, i] { results[i] = RunQuery(*buffer, QUERY_CASES[i % QUERY_CASE_NUM]); });
+    }
+    for (auto &client : clients) {
+        client.join();
+    }
+    for (unsigned int i = 0; i < CLIENTS; i++) {
+        EXPECT_TRUE(results[i] == expected[i % QUERY_CASE_NUM]) << "client " << i;
+    }
+}
+
+/**
+ * @tc.name: Dfx_LogQuerierTest_ControlReplies_001
+ * @tc.desc: A control client that sends many requests before it reads the replies.
+ * @tc.type: FUNC
+ */
+HWTEST_F(LogQuerierTest, ControlReplies_001, TestSize.Level1)
+{
+    /**
+     * @tc.steps: step1. Send CONTROL_REQUESTS buffer size and resize requests in turn, a resize to the size
+     *                   the buffer has, and read the replies only once the socket has filled up.
+     * @tc.expected: step1. Every request is answered, in the order they were sent.
+     */
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds), 0);
+    auto handler = std::make_unique<Socket>(SOCK_SEQPACKET);
+    handler->setHandler(fds[0]);
+    ASSERT_EQ(LogQuerierReactor::GetInstance().Add(std::move(handler), buffer), RET_SUCCESS);
+    uint64_t size = buffer->GetBuffLen(LOG_CORE);
+    std::thread sender([fd = fds[1], size] {
+        for (unsigned int i = 0; i < CONTROL_REQUESTS; i++) {
+            char msg[sizeof(MessageHeader) + sizeof(BuffResizeMsg)];
+            (void)memset_s(msg, sizeof(msg), 0, sizeof(msg));
+            MessageHeader *header = reinterpret_cast<MessageHeader *>(msg);
+            BuffResizeMsg *resize = reinterpret_cast<BuffResizeMsg *>(msg + sizeof(MessageHeader));
+            resize->logType = LOG_CORE;
+            resize->buffSize = size;
+            header->msgType = (i % 2 == 0) ? MC_REQ_BUFFER_SIZE : MC_REQ_BUFFER_RESIZE;
+            header->msgLen = (i % 2 == 0) ? sizeof(BuffSizeMsg) : sizeof(BuffResizeMsg);
+            if (send(fd, msg, sizeof(MessageHeader) + header->msgLen, 0) <= 0) {
+                return;
+            }
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); /* 200: for the socket to fill up */
+    timeval timeout = { 5, 0 }; /* 5: seconds, a reply that was dropped never comes */
+    (void)setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    unsigned int answered = 0;
+    for (; answered < CONTROL_REQUESTS; answered++) {
+        char reply[CONTROL_REPLY_LEN];
+        ssize_t len = recv(fds[1], reply, sizeof(reply), 0);
+        const MessageHeader *header = reinterpret_cast<const MessageHeader *>(reply);
+        if (len < static_cast<ssize_t>(sizeof(MessageHeader)) ||
+            header->msgType != ((answered % 2 == 0) ? MC_RSP_BUFFER_SIZE : MC_RSP_BUFFER_RESIZE)) {
+            break;
+        }
+    }
+    (void)shutdown(fds[1], SHUT_RDWR);
+    sender.join();
+    close(fds[1]);
+    EXPECT_EQ(answered, CONTROL_REQUESTS);
+    EXPECT_EQ(buffer->GetBuffLen(LOG_CORE), size);
+}
+} // namespace HiLogdTest
+} // namespace HiviewDFX
+} // namespace OHOS